@@ -0,0 +1,85 @@
+/*
+ * Measure samples per second on one core of the double,
+ * float and fixed point block conversions, and the largest
+ * error of float and fixed against double next to the
+ * bounds from NAU7802_convInit.  Needs no sensor.
+ *
+ * ./BenchConv [gain [shift [frac]]]
+ * ./BenchConv 0.25 0 8
+ */
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_conv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define BENCH_LEN 4096		/* samples per block */
+#define BENCH_NS 500000000ULL	/* time per path */
+
+static int32_t raw[BENCH_LEN];
+static double dload[BENCH_LEN];
+static float fload[BENCH_LEN];
+static int32_t qload[BENCH_LEN];
+
+static double
+rate(uint64_t blocks, uint64_t ns){
+	return blocks * (double)BENCH_LEN / (ns / 1e9);
+}
+
+int
+main(int argc, char **argv){
+	struct load_cal lc;
+	struct conv_cal cv;
+	uint64_t t0, t, blocks;
+	double ferr=0.0, qerr=0.0, e;
+	int i, frac=8;
+
+	NAU7802_init_load_cal(&lc);
+	NAU7802_setLoadCalGain(&lc, argc >= 2 ? atof(argv[1]) : 0.25);
+	NAU7802_setShiftLoad(&lc, argc >= 3 ? atoi(argv[2]) : 0);
+	NAU7802_setLoadCalZero(&lc, 12.5);
+	NAU7802_setOffsetLoad(&lc, 1000.0);
+	if(argc >= 4)
+		frac = atoi(argv[3]);
+	if(NAU7802_convInit(&cv, &lc, frac) == -1){
+		printf("Gain or zero too large for %d fraction bits\n", frac);
+		return 1;
+	}
+	srand(1);
+	for(i=0; i<BENCH_LEN; i++)
+		raw[i] = (int32_t)((((uint32_t)rand() << 8) ^ (uint32_t)rand()) << 8) >> 8;
+	raw[0] = 0x7FFFFF;
+	raw[1] = -0x800000;
+
+	NAU7802_getLoadFromADCBlock(&lc, raw, dload, BENCH_LEN);
+	NAU7802_convFloat(&cv, raw, fload, BENCH_LEN);
+	NAU7802_convFixed(&cv, raw, qload, BENCH_LEN);
+	for(i=0; i<BENCH_LEN; i++){
+		e = fabs(fload[i] - dload[i]);
+		if(e > ferr)
+			ferr = e;
+		e = fabs(ldexp(qload[i], -frac) - dload[i]);
+		if(e > qerr)
+			qerr = e;
+	}
+
+	printf("gain %g shift %d, float path %s, fixed Q%d with q=%d\n",
+			lc.gain, lc.shift, NAU7802_convPath(), frac, cv.q);
+	t0 = NAU7802_getTimestamp();
+	for(blocks=0; (t = NAU7802_getTimestamp() - t0) < BENCH_NS; blocks++)
+		NAU7802_getLoadFromADCBlock(&lc, raw, dload, BENCH_LEN);
+	printf("double : %12.0f samples/s\n", rate(blocks, t));
+	t0 = NAU7802_getTimestamp();
+	for(blocks=0; (t = NAU7802_getTimestamp() - t0) < BENCH_NS; blocks++)
+		NAU7802_convFloat(&cv, raw, fload, BENCH_LEN);
+	printf("float  : %12.0f samples/s  max error %.3g bound %.3g\n",
+			rate(blocks, t), ferr, cv.float_err);
+	t0 = NAU7802_getTimestamp();
+	for(blocks=0; (t = NAU7802_getTimestamp() - t0) < BENCH_NS; blocks++)
+		NAU7802_convFixed(&cv, raw, qload, BENCH_LEN);
+	printf("fixed  : %12.0f samples/s  max error %.3g bound %.3g\n",
+			rate(blocks, t), qerr, cv.fixed_err);
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Compare the CPU used to read NAU7802s with the blocking
+ * loop of NAU7802_driver.c, one thread per sensor spinning
+ * on NAU7802_CR, against one nau7802::executor thread
+ * serving all sensors with coroutines.
+ *
+ * ./BenchCoroutine spin|co seconds bus [bus ...]
+ * ./BenchCoroutine co 10 /dev/i2c-1 /dev/i2c-3
+ */
+
+/* include headers */
+#include "NAU7802.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#define BENCH_MAX_SENSORS 8
+
+struct spin_arg{
+	int fd;
+	struct load_cal *lc;
+	uint64_t end_ns;
+	uint64_t samples;
+	double sum;
+};
+
+/* the blocking loop of the driver tests */
+static void *
+spin_thread(void *p){
+	struct spin_arg *a = static_cast<struct spin_arg *>(p);
+	int adc;
+	while(NAU7802_getTimestamp() < a->end_ns){
+		while(!NAU7802_CR(a->fd));
+		adc = NAU7802_readADC(a->fd);
+		a->sum += NAU7802_getLoadFromADC(a->lc, adc);
+		a->samples++;
+	}
+	return NULL;
+}
+
+static nau7802::task
+reader(nau7802::sensor &s, nau7802::executor &ex, uint64_t end_ns,
+		uint64_t &samples, double &sum){
+	nau7802::sample x;
+	for(;;){
+		x = co_await s.next_sample();
+		sum += x.load;
+		samples++;
+		if(x.t_ns >= end_ns){
+			ex.stop();
+			co_return;
+		}
+	}
+}
+
+static double
+cpu_seconds(void){
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+		ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+int
+main(int argc, char **argv){
+	nau7802::executor ex;
+	nau7802::sensor *s[BENCH_MAX_SENSORS];
+	struct spin_arg arg[BENCH_MAX_SENSORS];
+	pthread_t th[BENCH_MAX_SENSORS];
+	uint64_t samples[BENCH_MAX_SENSORS] = {0}, total=0, start, end;
+	double sum[BENCH_MAX_SENSORS] = {0}, cpu, secs;
+	int i, n, z, co;
+
+	n = argc - 3;
+	if(n < 1 || n > BENCH_MAX_SENSORS ||
+		(strcmp(argv[1], "spin") != 0 && strcmp(argv[1], "co") != 0)){
+		printf("Usage : %s spin|co seconds bus [bus ...]\n", argv[0]);
+		return 1;
+	}
+	co = strcmp(argv[1], "co") == 0;
+	secs = atof(argv[2]);
+	for(i=0; i<n; i++){
+		s[i] = new nau7802::sensor(ex, argv[i + 3]);
+		if(s[i]->fd() < 0){
+			printf("Open Failed : %s\n", argv[i + 3]);
+			return 1;
+		}
+		if((z = s[i]->configure(128, CRS_320, V3_0)) != 0)
+			printf("Configure Failed : %s %d\n", argv[i + 3], z);
+		NAU7802_setLoadCalGain(&s[i]->cal(), 0.25);
+		NAU7802_setShiftLoad(&s[i]->cal(), 0);
+	}
+
+	cpu = cpu_seconds();
+	start = NAU7802_getTimestamp();
+	end = start + (uint64_t)(secs * 1e9);
+	if(co){
+		/* the tasks own their frames, allocated once here */
+		nau7802::task *t[BENCH_MAX_SENSORS];
+		for(i=0; i<n; i++)
+			t[i] = new nau7802::task(reader(*s[i], ex, end, samples[i], sum[i]));
+		ex.run();
+		for(i=0; i<n; i++)
+			delete t[i];
+	}
+	else{
+		for(i=0; i<n; i++){
+			arg[i] = {s[i]->fd(), &s[i]->cal(), end, 0, 0.0};
+			pthread_create(&th[i], NULL, spin_thread, &arg[i]);
+		}
+		for(i=0; i<n; i++){
+			pthread_join(th[i], NULL);
+			samples[i] = arg[i].samples;
+		}
+	}
+	secs = (NAU7802_getTimestamp() - start) / 1e9;
+	cpu = cpu_seconds() - cpu;
+
+	for(i=0; i<n; i++){
+		printf("%s : %8.1f SPS\n", argv[i + 3], samples[i] / secs);
+		total += samples[i];
+	}
+	printf("%s : %.3f s CPU in %.3f s, %.1f %% CPU per sensor, %.2f us per sample\n",
+			argv[1], cpu, secs, 100.0 * cpu / secs / n,
+			total ? cpu * 1e6 / total : 0.0);
+	if(co)
+		printf("polls without conversion : %llu\n",
+				(unsigned long long)ex.misses());
+	for(i=0; i<n; i++)
+		delete s[i];
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Compare the CPU time and I2C transactions per sample of
+ * the spin on NAU7802_CR in NAU7802_driver.c against
+ * NAU7802_schedWait, which sleeps until just before the
+ * predicted conversion.  One thread per sensor.
+ *
+ * ./BenchPoll spin|sleep seconds bus [bus ...]
+ * ./BenchPoll sleep 10 /dev/i2c-1 /dev/i2c-3
+ */
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_dev.h"
+#include "NAU7802_sched.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#define BENCH_MAX_SENSORS 8
+
+struct poll_arg{
+	struct nau7802_dev dev;
+	struct sched_entry se;
+	int sleep;		/* 1 for NAU7802_schedWait, 0 to spin */
+	uint64_t end_ns;
+	uint64_t samples;
+	double sum;
+};
+
+static struct poll_arg arg[BENCH_MAX_SENSORS];
+
+static void *
+poll_thread(void *p){
+	struct poll_arg *a = p;
+	int fd = a->dev.fd, adc;
+	NAU7802_bindStats(&a->dev.stats);
+	NAU7802_schedInit(&a->se, a->dev.rate, NAU7802_getTimestamp());
+	while(NAU7802_getTimestamp() < a->end_ns){
+		if(a->sleep){
+			if(!NAU7802_schedWait(&a->se, fd))
+				continue;
+		}
+		else
+			while(!NAU7802_CR(fd));
+		adc = NAU7802_readADC(fd);
+		a->sum += NAU7802_getLoadFromADC(&a->dev.lc, adc);
+		a->samples++;
+	}
+	return NULL;
+}
+
+static double
+cpu_seconds(void){
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+		ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+int
+main(int argc, char **argv){
+	struct nau7802_stats st;
+	pthread_t th[BENCH_MAX_SENSORS];
+	struct poll_arg *a;
+	uint64_t total=0, start, end;
+	double cpu, secs;
+	int i, n, z, sleep;
+
+	n = argc - 3;
+	if(n < 1 || n > BENCH_MAX_SENSORS ||
+		(strcmp(argv[1], "spin") != 0 && strcmp(argv[1], "sleep") != 0)){
+		printf("Usage : %s spin|sleep seconds bus [bus ...]\n", argv[0]);
+		return 1;
+	}
+	sleep = strcmp(argv[1], "sleep") == 0;
+	secs = atof(argv[2]);
+	for(i=0; i<n; i++){
+		a = &arg[i];
+		if(NAU7802_devOpen(&a->dev, argv[i + 3], NAU7802_ADDR) == -1){
+			printf("Open Failed : %s\n", argv[i + 3]);
+			return 1;
+		}
+		if((z = NAU7802_devConfigure(&a->dev, 128, CRS_320, V3_0)) != 0)
+			printf("Configure Failed : %s %d\n", argv[i + 3], z);
+		NAU7802_setLoadCalGain(&a->dev.lc, 0.25);
+		NAU7802_setShiftLoad(&a->dev.lc, 0);
+		a->sleep = sleep;
+	}
+
+	cpu = cpu_seconds();
+	start = NAU7802_getTimestamp();
+	end = start + (uint64_t)(secs * 1e9);
+	for(i=0; i<n; i++){
+		NAU7802_resetStats(&arg[i].dev.stats);
+		arg[i].end_ns = end;
+		pthread_create(&th[i], NULL, poll_thread, &arg[i]);
+	}
+	for(i=0; i<n; i++)
+		pthread_join(th[i], NULL);
+	secs = (NAU7802_getTimestamp() - start) / 1e9;
+	cpu = cpu_seconds() - cpu;
+
+	for(i=0; i<n; i++){
+		a = &arg[i];
+		NAU7802_getStats(&a->dev.stats, &st);
+		printf("%s : %8.1f SPS  %.2f I2C transactions and %.2f CR polls per sample"
+				"  missed %llu\n", argv[i + 3], a->samples / secs,
+				a->samples ? (double)(st.reads + st.writes) / a->samples : 0.0,
+				a->samples ? (double)st.cr_polls / a->samples : 0.0,
+				(unsigned long long)st.missed);
+		if(sleep)
+			printf("%*s   guard %.1f us  late wakes %u  mean latency %.1f us\n",
+					(int)strlen(argv[i + 3]), "", a->se.guard_ns / 1e3,
+					a->se.late, NAU7802_schedLatency(&a->se) / 1e3);
+		total += a->samples;
+	}
+	printf("%s : %.3f s CPU in %.3f s, %.1f %% CPU per sensor, %.2f us per sample\n",
+			argv[1], cpu, secs, 100.0 * cpu / secs / n,
+			total ? cpu * 1e6 / total : 0.0);
+	for(i=0; i<n; i++)
+		NAU7802_devClose(&arg[i].dev);
+	return 0;
+}
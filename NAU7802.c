@@ -7,6 +7,93 @@
 #include "NAU7802.h"
 #include <stdlib.h>
 #include <stdint.h>
+#include <time.h>
+#include <string.h>
+
+/*
+ * Counters of the device the calling thread works on, see
+ * NAU7802_bindStats.  Several threads may count into one
+ * device, so counters are relaxed atomics: no locks, and no
+ * torn 64 bit values on 32 bit ARM.
+ */
+static _Thread_local struct nau7802_stats *bound;
+
+#define STAT_ADD(st, f, n) __atomic_fetch_add(&(st)->f, (n), __ATOMIC_RELAXED)
+#define STAT_GET(st, f) __atomic_load_n(&(st)->f, __ATOMIC_RELAXED)
+#define STAT_SET(st, f, v) __atomic_store_n(&(st)->f, (v), __ATOMIC_RELAXED)
+
+/* retry policy of failed transactions, see NAU7802_setRetry */
+static int retry_count = NAU7802_RETRIES;
+static unsigned int retry_us = NAU7802_RETRY_US;
+
+/*
+ * wiringPiI2CReadReg8 that counts the transaction
+ * and retries it on failure.
+ */
+static int
+i2c_read8(int fd, int reg){
+	struct nau7802_stats *st = bound;
+	int r, i=0;
+	for(;;){
+		r = wiringPiI2CReadReg8(fd, reg);
+		if(st){
+			STAT_ADD(st, reads, 1);
+			STAT_ADD(st, bytes, 2);
+			if(r < 0)
+				STAT_ADD(st, errors, 1);
+		}
+		if(r >= 0 || i++ >= retry_count)
+			return r;
+		if(st)
+			STAT_ADD(st, retries, 1);
+		delayMicroseconds(retry_us);
+	}
+}
+
+/*
+ * wiringPiI2CWriteReg8 that counts the transaction
+ * and retries it on failure.
+ */
+static int
+i2c_write8(int fd, int reg, int data){
+	struct nau7802_stats *st = bound;
+	int r, i=0;
+	for(;;){
+		r = wiringPiI2CWriteReg8(fd, reg, data);
+		if(st){
+			STAT_ADD(st, writes, 1);
+			STAT_ADD(st, bytes, 2);
+			if(r < 0)
+				STAT_ADD(st, errors, 1);
+		}
+		if(r >= 0 || i++ >= retry_count)
+			return r;
+		if(st)
+			STAT_ADD(st, retries, 1);
+		delayMicroseconds(retry_us);
+	}
+}
+
+/*
+ * Count a sample read at t_ns and the conversions
+ * missed since the last one.
+ */
+static void
+stats_sample(uint64_t t_ns){
+	struct nau7802_stats *st = bound;
+	uint64_t period, last, n;
+	if(st == NULL)
+		return;
+	period = STAT_GET(st, period_ns);
+	last = STAT_GET(st, last_ns);
+	if(period && STAT_GET(st, samples) && t_ns > last){
+		n = (t_ns - last + period / 2) / period;
+		if(n > 1)
+			STAT_ADD(st, missed, n - 1);
+	}
+	STAT_ADD(st, samples, 1);
+	STAT_SET(st, last_ns, t_ns);
+}
 
 /*
  * Initialize NAU7802. Clear registers using RR bit,
@@ -18,8 +105,8 @@
  */
 int
 NAU7802_init(int fd){
-	wiringPiI2CWriteReg8(fd, PU_CTRL, RESET);
-	wiringPiI2CWriteReg8(fd, PU_CTRL, NORMAL_OP); 
+	i2c_write8(fd, PU_CTRL, RESET);
+	i2c_write8(fd, PU_CTRL, NORMAL_OP); 
 	delayMicroseconds(200);
 	return NAU7802_readBit(fd, PU_CTRL, PUR);
 }
@@ -35,8 +122,8 @@ NAU7802_init(int fd){
 int
 NAU7802_enable(int fd){
 	unsigned int reg;
-	wiringPiI2CWriteReg8(fd, PU_CTRL, ENABLE);
-	reg = wiringPiI2CReadReg8(fd, PU_CTRL);
+	i2c_write8(fd, PU_CTRL, ENABLE);
+	reg = i2c_read8(fd, PU_CTRL);
 	reg = reg >> 1;
 	reg &= 0x0F;
 	return (int)(reg == 0x0F);
@@ -81,17 +168,84 @@ NAU7802_resetPowerDown(int fd){
  * Read Cycle Ready (CR) bit from R0x00(PU_CTRL) on
  * NAU7802. 
  * *** Did not use readBit to keep this read as fast
- * as possible ***
+ * as possible ***  A read that failed after its
+ * retries is not ready, see NAU7802_pollCR.
  *
  * Return CR bit.
  */
 int
 NAU7802_CR(int fd){
-	unsigned int cr;
-	cr = wiringPiI2CReadReg8(fd, PU_CTRL);
-	cr = cr >> 5;
-	cr &= 0x01;
-	return (int)cr;
+	return NAU7802_pollCR(fd) == 1;
+}
+
+/*
+ * Read the CR bit once.  For loops that wait their
+ * own way; not ready is not a timeout.
+ *
+ * Return 1 when ready, 0 if not or -1 if the read
+ * failed after its retries.
+ */
+int
+NAU7802_pollCR(int fd){
+	int cr;
+	if(bound)
+		STAT_ADD(bound, cr_polls, 1);
+	cr = i2c_read8(fd, PU_CTRL);
+	if(cr < 0)
+		return -1;
+	return (cr >> CR) & 0x01;
+}
+
+/*
+ * Poll the CR bit until a conversion is ready or
+ * CLOCK_MONOTONIC passes deadline_ns, which counts
+ * a timeout.  A deadline already passed polls once.
+ *
+ * Return 1 when ready, 0 at the deadline or -1 if
+ * a read failed after its retries.
+ */
+int
+NAU7802_waitCR(int fd, uint64_t deadline_ns){
+	int cr;
+	for(;;){
+		cr = NAU7802_pollCR(fd);
+		if(cr != 0)
+			return cr;
+		if(NAU7802_getTimestamp() >= deadline_ns){
+			if(bound)
+				STAT_ADD(bound, timeouts, 1);
+			return 0;
+		}
+	}
+}
+
+/*
+ * Get the deadline for the next conversion of fd,
+ * NAU7802_WAIT_PERIODS conversion periods from now.
+ * The period is the one NAU7802_setSampleRate stored
+ * in the counters bound with NAU7802_bindStats, or
+ * NAU7802_WAIT_NS is waited if there are none.  Used
+ * by the functions that wait for a conversion.
+ *
+ * Return CLOCK_MONOTONIC deadline in ns.
+ */
+uint64_t
+NAU7802_deadline(int fd){
+	uint64_t wait = NAU7802_WAIT_NS;
+	if(bound && STAT_GET(bound, period_ns))
+		wait = NAU7802_WAIT_PERIODS * STAT_GET(bound, period_ns);
+	return NAU7802_getTimestamp() + wait;
+}
+
+/*
+ * Set how often a failed register read or write
+ * is retried and the delay before each retry, for
+ * all fds.  0 retries gives up on the first failure.
+ */
+void
+NAU7802_setRetry(int retries, unsigned int delay_us){
+	retry_count = retries > 0 ? retries : 0;
+	retry_us = delay_us;
 }
 
 /*
@@ -123,11 +277,11 @@ NAU7802_setGain(int fd, int gain){
 		g = 0x00;
 	else
 		return -1;
-	reg = wiringPiI2CReadReg8(fd, CTRL1);
+	reg = i2c_read8(fd, CTRL1);
 	reg &= 0xf8; /* zero lower 3 bits */
 	g = g | reg;
-	wiringPiI2CWriteReg8(fd, CTRL1, g);
-	g = wiringPiI2CReadReg8(fd, CTRL1);
+	i2c_write8(fd, CTRL1, g);
+	g = i2c_read8(fd, CTRL1);
 	g &= 0x07;
 	return (int)g;
 }
@@ -150,9 +304,10 @@ int
 NAU7802_readADCS(int fd, int8_t shift){
 	int32_t adc;
 	int8_t r_shift=8;
-	adc = wiringPiI2CReadReg8(fd, ADCO_B2) << 24;
-	adc |= wiringPiI2CReadReg8(fd, ADCO_B1) << 16;
-	adc |= wiringPiI2CReadReg8(fd, ADCO_B0) << 8;
+	adc = i2c_read8(fd, ADCO_B2) << 24;
+	adc |= i2c_read8(fd, ADCO_B1) << 16;
+	adc |= i2c_read8(fd, ADCO_B0) << 8;
+	stats_sample(NAU7802_getTimestamp());
 	return (int)(adc >> (r_shift+shift));
 }
 
@@ -166,6 +321,28 @@ NAU7802_readADC(int fd){
 	return (int)NAU7802_readADCS(fd, 0);
 }
 
+/*
+ * Read the raw value from the ADC like
+ * NAU7802_readADC, but report a failed read
+ * instead of returning a wrong value.
+ *
+ * Return 0 or -1 if a read failed, raw is
+ * not set then.
+ */
+int
+NAU7802_readRaw(int fd, int32_t *raw){
+	int b2, b1, b0;
+	b2 = i2c_read8(fd, ADCO_B2);
+	b1 = i2c_read8(fd, ADCO_B1);
+	b0 = i2c_read8(fd, ADCO_B0);
+	stats_sample(NAU7802_getTimestamp());
+	if(b2 < 0 || b1 < 0 || b0 < 0)
+		return -1;
+	*raw = (int32_t)((uint32_t)b2 << 24 | (uint32_t)b1 << 16 |
+			(uint32_t)b0 << 8) >> 8;
+	return 0;
+}
+
 /*
  * Set the LDO voltage.
  * Before using this the LDO bit 7 of PU_CTRL
@@ -192,11 +369,11 @@ NAU7802_setLDO(int fd, int voltage){
 		voltage == V2_4))
 		return -1;
 
-	reg = wiringPiI2CReadReg8(fd, CTRL1);
+	reg = i2c_read8(fd, CTRL1);
 	reg &= 0xC7; /* zero bits 5:3 */ 
 	v = reg | (voltage << 3);
-	wiringPiI2CWriteReg8(fd, CTRL1, v);
-	v = wiringPiI2CReadReg8(fd, CTRL1);
+	i2c_write8(fd, CTRL1, v);
+	v = i2c_read8(fd, CTRL1);
 	v = v >> 3;
 	v &= 0x07;
 	return (int)v;
@@ -251,7 +428,7 @@ NAU7802_readBit(int fd, int reg, uint8_t bit){
 	else
 		return -1;
 	
-	r = wiringPiI2CReadReg8(fd, reg);
+	r = i2c_read8(fd, reg);
 	b = r & mask; 
 	return (int)(b >> bit);
 }
@@ -284,11 +461,11 @@ NAU7802_writeBit(int fd, int reg, uint8_t bit, uint8_t val){
 	else
 		return -1;
 
-	r = wiringPiI2CReadReg8(fd, reg);
+	r = i2c_read8(fd, reg);
 	b = val << bit; /* move val into bit pso */
 	r = r & mask; /* set bit in reg to 0 */
 	b |= r; /* put bit val into reg */
-	wiringPiI2CWriteReg8(fd, reg, b);
+	i2c_write8(fd, reg, b);
 	return NAU7802_readBit(fd, reg, bit);
 }
 
@@ -316,29 +493,69 @@ NAU7802_readRegByBit(int fd, int reg){
  * tsignificant temp change. sample rate change,
  * channel select change. caltype should be supplied
  * with a macro.
- * Blocks until calibrtion is finished.
+ * Blocks until calibrtion is finished, at most
+ * NAU7802_CAL_NS.
  * Add a delay of 1 second before reading any calibration
  * registers.  This is needed to allow
  * time for values to be written to calibration registers
  * for correct readings if done immediately after.
  *
  * Return CAL_ERR status bit. 1=ERROR, 0=NO ERROR.
- * Return -1 on caltype error.
+ * Return -1 on caltype error or -2 if it did not
+ * finish in time.
  */
 int
 NAU7802_calibrate(int fd, uint8_t caltype){
+	return NAU7802_calibrateDeadline(fd, caltype,
+			NAU7802_getTimestamp() + NAU7802_CAL_NS);
+}
+
+/*
+ * Calibrate like NAU7802_calibrate but stop waiting
+ * for CALS to reset when CLOCK_MONOTONIC passes
+ * deadline_ns.
+ *
+ * Return CAL_ERR status bit. 1=ERROR, 0=NO ERROR.
+ * Return -1 on caltype error or -2 at the deadline
+ * or if a read failed.
+ */
+int
+NAU7802_calibrateDeadline(int fd, uint8_t caltype, uint64_t deadline_ns){
 	uint8_t reg;
+	uint64_t t0;
+	int r, z;
 	if(!(	caltype == CALMOD_GCS ||
 		caltype == CALMOD_OCS ||
 		caltype == CALMOD_OCI))
 		return -1;
 	
-	reg = wiringPiI2CReadReg8(fd, CTRL2);
+	t0 = NAU7802_getTimestamp();
+	reg = i2c_read8(fd, CTRL2);
 	reg &= 0xF8; /* zero bits 2:0 */
 	reg |= (caltype | 0x04);
-	wiringPiI2CWriteReg8(fd, CTRL2, reg);
-	while(!(NAU7802_readBit(fd, CTRL2, CALS)));
-	return NAU7802_readBit(fd, CTRL2, CAL_ERR);
+	i2c_write8(fd, CTRL2, reg);
+	for(;;){
+		r = i2c_read8(fd, CTRL2);
+		if(r < 0){
+			z = -2;
+			break;
+		}
+		if(!(r & (1 << CALS))){
+			z = (r >> CAL_ERR) & 0x01;
+			break;
+		}
+		if(NAU7802_getTimestamp() >= deadline_ns){
+			if(bound)
+				STAT_ADD(bound, timeouts, 1);
+			z = -2;
+			break;
+		}
+	}
+	if(bound){
+		STAT_ADD(bound, cals, 1);
+		STAT_ADD(bound, cal_ns, NAU7802_getTimestamp() - t0);
+	}
+	return z;
 }
 
 /*
@@ -354,11 +571,11 @@ NAU7802_calibrate(int fd, uint8_t caltype){
 int
 NAU7802_ch1ReadOffsetCal(int fd){
 	uint32_t offset;
-	offset = wiringPiI2CReadReg8(fd, OCAL1_B2) << 24;
+	offset = i2c_read8(fd, OCAL1_B2) << 24;
 	//printf("offset_B2 : %i\t", offset);
-	offset |= wiringPiI2CReadReg8(fd, OCAL1_B1) << 16;
+	offset |= i2c_read8(fd, OCAL1_B1) << 16;
 	//printf("offset_B1 : %i\t", offset);
-	offset |= wiringPiI2CReadReg8(fd, OCAL1_B0) << 8;
+	offset |= i2c_read8(fd, OCAL1_B0) << 8;
 	//printf("offset_B0 : %i\n", offset);
 	return (int)(offset >> 8);
 }
@@ -377,13 +594,13 @@ NAU7802_ch1ReadOffsetCal(int fd){
 int
 NAU7802_ch1ReadGainCal(int fd){
 	uint32_t gain;
-	gain = wiringPiI2CReadReg8(fd, GCAL1_B3) ;
+	gain = i2c_read8(fd, GCAL1_B3) ;
 	//printf("gain_B3 : %X\t", gain);
-	gain = wiringPiI2CReadReg8(fd, GCAL1_B2) ;
+	gain = i2c_read8(fd, GCAL1_B2) ;
 	//printf("gain_B2 : %X\t", gain);
-	gain = wiringPiI2CReadReg8(fd, GCAL1_B1) ;
+	gain = i2c_read8(fd, GCAL1_B1) ;
 	//printf("gain_B1 : %X\t", gain);
-	gain = wiringPiI2CReadReg8(fd, GCAL1_B0);
+	gain = i2c_read8(fd, GCAL1_B0);
 	//printf("gain_B0 : %X\n", gain);
 	return (int)gain;
 }
@@ -401,9 +618,9 @@ NAU7802_ch1ReadGainCal(int fd){
 int
 NAU7802_ch2ReadOffsetCal(int fd){
 	int32_t offset;
-	offset = wiringPiI2CReadReg8(fd, OCAL2_B2) << 24;
-	offset |= wiringPiI2CReadReg8(fd, OCAL2_B1) << 16;
-	offset |= wiringPiI2CReadReg8(fd, OCAL2_B0) << 8;
+	offset = i2c_read8(fd, OCAL2_B2) << 24;
+	offset |= i2c_read8(fd, OCAL2_B1) << 16;
+	offset |= i2c_read8(fd, OCAL2_B0) << 8;
 	return (int)(offset >> 8);
 }
 
@@ -420,13 +637,96 @@ NAU7802_ch2ReadOffsetCal(int fd){
 int
 NAU7802_ch2ReadGainCal(int fd){
 	int32_t gain;
-	gain = wiringPiI2CReadReg8(fd, GCAL2_B3) << 24;
-	gain |= wiringPiI2CReadReg8(fd, GCAL2_B2) << 16;
-	gain |= wiringPiI2CReadReg8(fd, GCAL2_B1) << 8;
-	gain |= wiringPiI2CReadReg8(fd, GCAL2_B0);
+	gain = i2c_read8(fd, GCAL2_B3) << 24;
+	gain |= i2c_read8(fd, GCAL2_B2) << 16;
+	gain |= i2c_read8(fd, GCAL2_B1) << 8;
+	gain |= i2c_read8(fd, GCAL2_B0);
 	return (int)gain;
 }
 
+/*
+ * Read the offset and gain calibration of
+ * channel ch, 1 or 2, all bytes at once.  Delay
+ * 1 sec after calibrating as for the ch1 and
+ * ch2 functions.
+ *
+ * Return 0 or -1 on invalid channel or a failed read.
+ */
+int
+NAU7802_readCal(int fd, int ch, int32_t *offset, uint32_t *gain){
+	int reg, b[7], i;
+	if(ch == 1)
+		reg = OCAL1_B2;
+	else if(ch == 2)
+		reg = OCAL2_B2;
+	else
+		return -1;
+	for(i=0; i<7; i++)
+		if((b[i] = i2c_read8(fd, reg + i)) < 0)
+			return -1;
+	*offset = (int32_t)((uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 |
+			(uint32_t)b[2] << 8) >> 8;
+	*gain = (uint32_t)b[3] << 24 | (uint32_t)b[4] << 16 |
+		(uint32_t)b[5] << 8 | (uint32_t)b[6];
+	return 0;
+}
+
+/*
+ * Write the offset and gain calibration of
+ * channel ch, 1 or 2, e.g. values saved with
+ * NAU7802_readCal, instead of calibrating again.
+ *
+ * Return 0 or -1 on invalid channel or a failed write.
+ */
+int
+NAU7802_writeCal(int fd, int ch, int32_t offset, uint32_t gain){
+	int reg, b[7], i;
+	if(ch == 1)
+		reg = OCAL1_B2;
+	else if(ch == 2)
+		reg = OCAL2_B2;
+	else
+		return -1;
+	b[0] = (offset >> 16) & 0xFF;
+	b[1] = (offset >> 8) & 0xFF;
+	b[2] = offset & 0xFF;
+	b[3] = (gain >> 24) & 0xFF;
+	b[4] = (gain >> 16) & 0xFF;
+	b[5] = (gain >> 8) & 0xFF;
+	b[6] = gain & 0xFF;
+	for(i=0; i<7; i++)
+		if(i2c_write8(fd, reg + i, b[i]) < 0)
+			return -1;
+	return 0;
+}
+
+/*
+ * Select analog input channel ch, 1 or 2, with
+ * the CHS bit.  Conversions right after switching
+ * are not settled and should be discarded.
+ *
+ * Return CHS bit or -1 on invalid channel.
+ */
+int
+NAU7802_selectChannel(int fd, int ch){
+	if(ch != 1 && ch != 2)
+		return -1;
+	return NAU7802_writeBit(fd, CTRL2, CHS, ch - 1);
+}
+
+/*
+ * Route the internal temperature sensor to the
+ * PGA input instead of VIN1/VIN2 when on is 1.
+ * Conversions right after switching are not
+ * settled and should be discarded.
+ *
+ * Return TS bit.
+ */
+int
+NAU7802_selectTempSensor(int fd, int on){
+	return NAU7802_writeBit(fd, I2C_CONTROL, TS, on ? 1 : 0);
+}
+
 /*
  * Read Chip Revision ID.
  *
@@ -435,7 +735,7 @@ NAU7802_ch2ReadGainCal(int fd){
 int
 NAU7802_getChipRevId(int fd){
 	uint8_t id;
-	id = wiringPiI2CReadReg8(fd, DRC) & 0x0F;
+	id = i2c_read8(fd, DRC) & 0x0F;
 	return (int)id;
 }
 
@@ -539,31 +839,121 @@ NAU7802_enablePGAChopper(int fd){
  */
 double
 NAU7802_getLinearLoad(int fd, struct load_cal *lc){
-	return NAU7802_readADCS(fd, lc->shift) 
+	return NAU7802_getLoadFromADC(lc, NAU7802_readADC(fd));
+}
+
+/*
+ * Convert a raw ADC value from NAU7802_readADC
+ * to a load.  Same as NAU7802_getLinearLoad for a
+ * value that was already read, so raw samples can be
+ * kept and converted without a second read.
+ *
+ * Returns load value.
+ */
+double
+NAU7802_getLoadFromADC(struct load_cal *lc, int adc){
+	return (adc >> lc->shift)
 		* lc->gain
 		+ lc->zero
 	       	- lc->offset;
 }
 
+/*
+ * Read n conversions into the arrays of out, waiting
+ * for each one.  Unlike NAU7802_readADC a failed I2C
+ * read is flagged with SAMPLE_IO_ERR in status.  n is
+ * limited to out->len.  If a conversion does not come
+ * before NAU7802_deadline it is flagged SAMPLE_TIMEOUT
+ * and is the last one read.
+ *
+ * Return the number of samples read.
+ */
+int
+NAU7802_readSamples(int fd, int n, struct sample_block *out){
+	int i, b2, b1, b0, cr;
+	uint64_t deadline;
+	uint8_t st;
+	if(n > out->len)
+		n = out->len;
+	for(i=0; i<n; i++){
+		st = SAMPLE_WAITING;
+		deadline = NAU7802_deadline(fd);
+		for(;;){
+			if(bound)
+				STAT_ADD(bound, cr_polls, 1);
+			cr = i2c_read8(fd, PU_CTRL);
+			if(cr < 0 || (cr & (1 << CR)))
+				break;
+			st = 0;
+			if(NAU7802_getTimestamp() >= deadline){
+				if(bound)
+					STAT_ADD(bound, timeouts, 1);
+				out->raw[i] = 0;
+				out->t_ns[i] = NAU7802_getTimestamp();
+				out->status[i] = SAMPLE_TIMEOUT;
+				return i + 1;
+			}
+		}
+		b2 = i2c_read8(fd, ADCO_B2);
+		b1 = i2c_read8(fd, ADCO_B1);
+		b0 = i2c_read8(fd, ADCO_B0);
+		out->t_ns[i] = NAU7802_getTimestamp();
+		stats_sample(out->t_ns[i]);
+		if(cr < 0 || b2 < 0 || b1 < 0 || b0 < 0)
+			st |= SAMPLE_IO_ERR;
+		out->raw[i] = (int32_t)((uint32_t)b2 << 24 | (uint32_t)b1 << 16 |
+				(uint32_t)b0 << 8) >> 8;
+		out->status[i] = st;
+	}
+	return n;
+}
+
+/*
+ * Convert n raw values from NAU7802_readSamples or
+ * NAU7802_readADC to loads, same as
+ * NAU7802_getLoadFromADC on each up to rounding.
+ * The loop has no calls or branches so the
+ * compiler can vectorize it.
+ */
+void
+NAU7802_getLoadFromADCBlock(struct load_cal *lc, const int32_t *restrict raw,
+		double *restrict load, int n){
+	const double gain = lc->gain;
+	const double zero = lc->zero - lc->offset;
+	const int shift = lc->shift;
+	int i;
+	for(i=0; i<n; i++)
+		load[i] = (raw[i] >> shift) * gain + zero;
+}
+
 /*
  * Get an average of the load readout.  This is based
  * on the sample rate. Number of samples to average
  * is rate / 10.  This means no average will be done
  * for rate of 10.  This keeps the minimum rate for
- * data at 10Hz.
+ * data at 10Hz.  Stops early if a conversion does
+ * not come before NAU7802_deadline.
  *
- * Return the average load.
+ * Return the average load or DBL_MAX if the
+ * sample rate could not be read or a conversion
+ * did not come in time.
  */
 double
 NAU7802_getAvgLinearLoad(int fd, struct load_cal *lc){
 	long double avg=0.0;
-	int i, rate;
+	uint64_t deadline;
+	int i, n, rate;
 	rate = NAU7802_getSampleRate(fd);
-	for(i=0; i<(rate/10); ++i){
-		while(!(NAU7802_CR(fd)));
+	if(rate == -1)
+		return DBL_MAX;
+	n = rate / 10;
+	for(i=0; i<n; ++i){
+		deadline = NAU7802_deadline(fd);
+		if(NAU7802_waitCR(fd, deadline) != 1)
+			return DBL_MAX;
 		avg += NAU7802_getLinearLoad(fd, lc);
 	}
-	return  (double)(avg / rate);
+	return  (double)(avg / n);
 }
 
 /*
@@ -575,13 +965,24 @@ NAU7802_getAvgLinearLoad(int fd, struct load_cal *lc){
  */
 double
 NAU7802_getSmoothLoad(int fd, struct load_cal *lc){
+	return NAU7802_getSmoothLoadFromADC(lc, NAU7802_readADC(fd));
+}
+
+/*
+ * Apply the low pass filter of NAU7802_getSmoothLoad
+ * to a raw ADC value that was already read, e.g.
+ * from a recording.
+ *
+ * Return smoothed load value.
+ */
+double
+NAU7802_getSmoothLoadFromADC(struct load_cal *lc, int adc){
 	float rawLoad;
-	rawLoad = NAU7802_getLinearLoad(fd, lc);
+	rawLoad = NAU7802_getLoadFromADC(lc, adc);
 	lc->smoothLoad = lc->smoothLoad - (lc->LPF_Beta * (lc->smoothLoad - rawLoad));
 	return lc->smoothLoad;
 }
 
-
 /*
  * Set the sample rate.  Use the Macros to
  * change the sample rate.
@@ -598,11 +999,13 @@ NAU7802_setSampleRate(int fd, uint8_t rate){
 		rate == CRS_80 ||
 		rate == CRS_320))
 		return -1;
-	reg = wiringPiI2CReadReg8(fd, CTRL2) & mask;
+	reg = i2c_read8(fd, CTRL2) & mask;
 	r = rate << 4;
 	r |= reg;
-	wiringPiI2CWriteReg8(fd, CTRL2, r);
-	reg = wiringPiI2CReadReg8(fd, CTRL2) >> 4;
+	i2c_write8(fd, CTRL2, r);
+	if(bound)
+		STAT_SET(bound, period_ns, NAU7802_ratePeriod(rate));
+	reg = i2c_read8(fd, CTRL2) >> 4;
 	return (int)(reg & 0x07);
 }
 
@@ -615,7 +1018,7 @@ NAU7802_setSampleRate(int fd, uint8_t rate){
 int
 NAU7802_getSampleRate(int fd){
 	uint8_t rate;
-	rate = wiringPiI2CReadReg8(fd, CTRL2) >> 4;
+	rate = i2c_read8(fd, CTRL2) >> 4;
 	rate &= 0x07;
 	if(rate == CRS_10)
 		return 10;
@@ -685,17 +1088,22 @@ NAU7802_getLoadCalZero(struct load_cal *lc){
  *
  * Returns the difference ofthe old offset and
  * new offset. Returns the macro constant DBL_MAX
- * int float.h on error reading sample rate.
+ * int float.h on error reading sample rate or a
+ * short read, the offset is left unchanged then.
  */
 double
 NAU7802_tareLoad(int fd, struct load_cal *lc){
-	double avg=0, old_offset;
+	double avg=0, load, old_offset;
 	int rate, i;
 	rate = NAU7802_getSampleRate(fd);
 	if(rate == -1)
 		return DBL_MAX;
-	for(i=rate; i>0; --i)
-		avg += NAU7802_getAvgLinearLoad(fd, lc);
+	for(i=rate; i>0; --i){
+		load = NAU7802_getAvgLinearLoad(fd, lc);
+		if(load == DBL_MAX)
+			return DBL_MAX;
+		avg += load;
+	}
 	avg = avg / rate;
 	old_offset = lc->offset;
 	lc->offset = avg;
@@ -775,3 +1183,89 @@ NAU7802_init_load_cal(struct load_cal *lc){
 	lc->smoothLoad = 0.0;
 	lc->LPF_Beta = 0.15;
 }
+
+/*
+ * Read CLOCK_MONOTONIC for timestamping samples.
+ * Not affected by changes to the wall clock.
+ *
+ * Return the time in nanoseconds.
+ */
+uint64_t
+NAU7802_getTimestamp(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Get the conversion period of a CRS rate macro.
+ * The rate in SPS is 1e9 / period.
+ *
+ * Return the period in ns or 0 on invalid rate.
+ */
+uint64_t
+NAU7802_ratePeriod(uint8_t rate){
+	if(rate == CRS_10)
+		return 100000000ULL;
+	else if(rate == CRS_20)
+		return 50000000ULL;
+	else if(rate == CRS_40)
+		return 25000000ULL;
+	else if(rate == CRS_80)
+		return 12500000ULL;
+	else if(rate == CRS_320)
+		return 3125000ULL;
+	return 0;
+}
+
+/*
+ * Count the transactions, samples and waits of
+ * the calling thread in st, or nowhere for NULL,
+ * until the next call.  Counters belong to one
+ * device: NAU7802_devLock binds the counters of
+ * its handle, so code that uses dev->fd under the
+ * lock counts into that device even when several
+ * chips share the fd behind a mux.
+ *
+ * Return the counters bound before.
+ */
+struct nau7802_stats *
+NAU7802_bindStats(struct nau7802_stats *st){
+	struct nau7802_stats *prev = bound;
+	bound = st;
+	return prev;
+}
+
+/*
+ * Copy the counters of st to out.  Each counter
+ * is read whole, but a copy taken while another
+ * thread reads may be off by the transactions in
+ * flight.
+ */
+void
+NAU7802_getStats(const struct nau7802_stats *st, struct nau7802_stats *out){
+	out->reads = STAT_GET(st, reads);
+	out->writes = STAT_GET(st, writes);
+	out->bytes = STAT_GET(st, bytes);
+	out->errors = STAT_GET(st, errors);
+	out->cr_polls = STAT_GET(st, cr_polls);
+	out->samples = STAT_GET(st, samples);
+	out->missed = STAT_GET(st, missed);
+	out->cals = STAT_GET(st, cals);
+	out->cal_ns = STAT_GET(st, cal_ns);
+	out->last_ns = STAT_GET(st, last_ns);
+	out->retries = STAT_GET(st, retries);
+	out->timeouts = STAT_GET(st, timeouts);
+	out->period_ns = STAT_GET(st, period_ns);
+}
+
+/*
+ * Zero the counters of st.  The conversion period
+ * used to count missed conversions is kept.
+ */
+void
+NAU7802_resetStats(struct nau7802_stats *st){
+	uint64_t period = STAT_GET(st, period_ns);
+	memset(st, 0, sizeof(*st));
+	STAT_SET(st, period_ns, period);
+}
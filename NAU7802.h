@@ -15,6 +15,10 @@
 #include <stdint.h>
 #include <float.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* define macros */
 /* device I2C address */
 #define NAU7802_ADDR 0x2A	/* load amp 12c address */
@@ -89,6 +93,9 @@
 #define CRS_80 0x03		/* CRS 80SPS */
 #define CRS_320 0x07		/* CRS 320SPS */
 
+/* bits for I2C_CONTROL register R0x11 */
+#define TS 1			/* 1=PGA input is the temperature sensor */
+
 /* bits for PGA register R0x1B */
 #define RD_OTP_SEL 7		/* read R0x15 output select 0=ADC 1=OTP */
 #define LDOMODE 6		/* 1=improved stab lower gain 0=improved accuracy higher gain */
@@ -100,6 +107,30 @@
 /* bits for Power Control register 0x1C */
 #define PGA_CAP_EN 7		/* enables PGA output bypass cap across Vin2p and Vin2N */
 
+/* default retry policy and wait deadlines */
+#define NAU7802_RETRIES 2		/* retries of a failed transaction */
+#define NAU7802_RETRY_US 100		/* delay before each retry */
+#define NAU7802_WAIT_PERIODS 4		/* conversions waited for before a timeout */
+#define NAU7802_WAIT_NS 500000000ULL	/* timeout while the rate is not known */
+#define NAU7802_CAL_NS 2000000000ULL	/* longest calibration */
+
+/* I2C and sample counters of one device, see NAU7802_bindStats */
+struct nau7802_stats{
+	uint64_t reads;		/* register reads */
+	uint64_t writes;	/* register writes */
+	uint64_t bytes;		/* bytes moved, register address included */
+	uint64_t errors;	/* reads and writes that returned -1 */
+	uint64_t cr_polls;	/* reads of the CR bit */
+	uint64_t samples;	/* conversions read */
+	uint64_t missed;	/* conversions lost between reads */
+	uint64_t cals;		/* calibrations run */
+	uint64_t cal_ns;	/* time spent calibrating */
+	uint64_t last_ns;	/* time of the last conversion read */
+	uint64_t retries;	/* failed transactions retried */
+	uint64_t timeouts;	/* waits that reached their deadline */
+	uint64_t period_ns;	/* conversion period from NAU7802_setSampleRate */
+};
+
 /* use for ADC to load conversion */
 struct load_cal{
 	double gain;		/* cal load multiplier */
@@ -110,6 +141,22 @@ struct load_cal{
 	double LPF_Beta;	/* smoothing filter 0<B<1 */
 };
 
+/* status bits of struct sample_block */
+#define SAMPLE_WAITING 0x01	/* conversion was ready on first poll, earlier ones may be lost */
+#define SAMPLE_IO_ERR 0x02	/* an I2C read failed, raw is not valid */
+#define SAMPLE_GAP 0x04		/* conversions were missed before this one */
+#define SAMPLE_DUP 0x08		/* conversion was already read */
+#define SAMPLE_OVERRUN 0x10	/* next conversion was due before the read */
+#define SAMPLE_TIMEOUT 0x20	/* no conversion before the deadline, raw is not valid */
+
+/* caller provided arrays of len samples each */
+struct sample_block{
+	int32_t *raw;		/* raw ADC values */
+	uint64_t *t_ns;		/* CLOCK_MONOTONIC time of read */
+	uint8_t *status;	/* SAMPLE_ status bits, 0 when good */
+	int len;		/* samples the arrays hold */
+};
+
 int NAU7802_init(int fd);
 
 int NAU7802_enable(int fd);
@@ -122,12 +169,22 @@ int NAU7802_resetPowerDown(int fd);
 
 int NAU7802_CR(int fd);
 
+int NAU7802_pollCR(int fd);
+
+int NAU7802_waitCR(int fd, uint64_t deadline_ns);
+
+uint64_t NAU7802_deadline(int fd);
+
+void NAU7802_setRetry(int retries, unsigned int delay_us);
+
 int NAU7802_setGain(int fd, int gain);
 
 int NAU7802_readADCS(int fd, int8_t shift);
 
 int NAU7802_readADC(int fd);
 
+int NAU7802_readRaw(int fd, int32_t *raw);
+
 int NAU7802_setLDO(int fd, int voltage);
 
 int NAU7802_AVDDSourceSelect(int fd, int source);
@@ -140,6 +197,8 @@ unsigned int NAU7802_readRegByBit(int fd, int reg);
 
 int NAU7802_calibrate(int fd, uint8_t caltype);
 
+int NAU7802_calibrateDeadline(int fd, uint8_t caltype, uint64_t deadline_ns);
+
 int NAU7802_ch1ReadOffsetCal(int fd);
 
 int NAU7802_ch1ReadGainCal(int fd);
@@ -148,6 +207,14 @@ int NAU7802_ch2ReadOffsetCal(int fd);
 
 int NAU7802_ch2ReadGainCal(int fd);
 
+int NAU7802_readCal(int fd, int ch, int32_t *offset, uint32_t *gain);
+
+int NAU7802_writeCal(int fd, int ch, int32_t offset, uint32_t gain);
+
+int NAU7802_selectChannel(int fd, int ch);
+
+int NAU7802_selectTempSensor(int fd, int on);
+
 int NAU7802_getChipRevId(int fd);
 
 int NAU7802_enablePGABypassCap(int fd);
@@ -168,10 +235,19 @@ int NAU7802_enablePGAChopper(int fd);
 
 double NAU7802_getLinearLoad(int fd, struct load_cal *lc);
 
+double NAU7802_getLoadFromADC(struct load_cal *lc, int adc);
+
+int NAU7802_readSamples(int fd, int n, struct sample_block *out);
+
+void NAU7802_getLoadFromADCBlock(struct load_cal *lc, const int32_t *raw,
+		double *load, int n);
+
 double NAU7802_getAvgLinearLoad(int fd, struct load_cal *lc);
 
 double NAU7802_getSmoothLoad(int fd, struct load_cal *lc);
 
+double NAU7802_getSmoothLoadFromADC(struct load_cal *lc, int adc);
+
 int NAU7802_setSampleRate(int fd, uint8_t rate);
 
 int NAU7802_getSampleRate(int fd);
@@ -198,4 +274,18 @@ int NAU7802_getShiftLoad(struct load_cal *lc);
 
 void NAU7802_init_load_cal(struct load_cal *lc);
 
+uint64_t NAU7802_getTimestamp(void);
+
+uint64_t NAU7802_ratePeriod(uint8_t rate);
+
+struct nau7802_stats *NAU7802_bindStats(struct nau7802_stats *st);
+
+void NAU7802_getStats(const struct nau7802_stats *st, struct nau7802_stats *out);
+
+void NAU7802_resetStats(struct nau7802_stats *st);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
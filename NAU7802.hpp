@@ -0,0 +1,277 @@
+/*
+ * C++20 coroutine front-end for the NAU7802 driver.
+ *
+ * A nau7802::sensor owns a struct nau7802_dev handle of one
+ * chip (NAU7802_dev.h), so it gets the same locking, cached
+ * settings and calibration and recovery as C code.  Inside a
+ * nau7802::task, co_await sensor.next_sample() suspends until
+ * the next conversion is read.  One nau7802::executor drives
+ * all sensors from a single thread: it sleeps until the
+ * earliest predicted ready time (see NAU7802_sched.h), polls
+ * that chip and resumes its waiter.  A failed read, or no
+ * conversion for stall_periods, recovers the chip with
+ * NAU7802_devRecover.  Nothing is allocated per sample; a
+ * task frame is allocated once when it starts.
+ *
+ *	nau7802::executor ex;
+ *	nau7802::sensor s(ex, "/dev/i2c-1");
+ *	s.configure(128, CRS_320, V3_0);
+ *	auto t = [](nau7802::sensor &s) -> nau7802::task {
+ *		for(;;){
+ *			auto x = co_await s.next_sample();
+ *			printf("%f\n", x.load);
+ *		}
+ *	}(s);
+ *	ex.run();
+ *
+ * Compile g++ with -std=c++20.
+ */
+
+#ifndef NAU7802_HPP
+#define NAU7802_HPP
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_dev.h"
+#include "NAU7802_sched.h"
+#include <coroutine>
+#include <exception>
+#include <cerrno>
+#include <ctime>
+
+namespace nau7802 {
+
+struct sample{
+	int32_t raw;		/* raw ADC value */
+	double load;		/* linear load */
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of read */
+};
+
+/*
+ * Coroutine that starts running when called and is
+ * destroyed with its task object.
+ */
+class task{
+public:
+	struct promise_type{
+		task get_return_object(){
+			return task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void(){}
+		void unhandled_exception(){ std::terminate(); }
+	};
+
+	task(task &&t) noexcept : h(t.h) { t.h = nullptr; }
+	task(const task &) = delete;
+	task &operator=(const task &) = delete;
+	~task(){
+		if(h)
+			h.destroy();
+	}
+	bool done() const { return !h || h.done(); }
+
+private:
+	explicit task(std::coroutine_handle<promise_type> c) : h(c) {}
+	std::coroutine_handle<promise_type> h;
+};
+
+class sensor;
+
+/*
+ * Single threaded loop over all sensors made with it.
+ */
+class executor{
+public:
+	executor() = default;
+	executor(const executor &) = delete;
+	executor &operator=(const executor &) = delete;
+
+	/*
+	 * Serve waiting sensors until none is waiting
+	 * or stop is called.
+	 */
+	inline void run();
+
+	void stop(){ running = false; }
+
+	/* polls of a chip that had no conversion */
+	uint64_t misses() const { return nmiss; }
+
+	/* samples read */
+	uint64_t samples() const { return nread; }
+
+	/* NAU7802_devRecover calls */
+	uint64_t recoveries() const { return nrecover; }
+
+	/* periods without a conversion before a chip is recovered */
+	static constexpr uint64_t stall_periods = 8;
+
+private:
+	friend class sensor;
+	sensor *sensors = nullptr;	/* all sensors, linked by next */
+	bool running = false;
+	uint64_t nmiss = 0;
+	uint64_t nread = 0;
+	uint64_t nrecover = 0;
+};
+
+/*
+ * One NAU7802 with its own struct nau7802_dev.  The
+ * fd is closed when the sensor is destroyed.
+ */
+class sensor{
+public:
+	sensor(executor &e, const char *bus, int addr = NAU7802_ADDR) : ex(e){
+		if(NAU7802_devOpen(&dev_, bus, addr) == -1)
+			NAU7802_devAttach(&dev_, -1);
+		NAU7802_schedInit(&se, dev_.rate, NAU7802_getTimestamp());
+		next = ex.sensors;
+		ex.sensors = this;
+	}
+
+	~sensor(){
+		sensor **p;
+		for(p = &ex.sensors; *p; p = &(*p)->next)
+			if(*p == this){
+				*p = next;
+				break;
+			}
+		NAU7802_devClose(&dev_);
+	}
+
+	sensor(const sensor &) = delete;
+	sensor &operator=(const sensor &) = delete;
+
+	/* fd for the functions in NAU7802.h, -1 if open failed */
+	int fd() const { return dev_.fd; }
+
+	/* handle for the functions in NAU7802_dev.h */
+	struct nau7802_dev &dev(){ return dev_; }
+
+	struct load_cal &cal(){ return dev_.lc; }
+
+	const struct sched_entry &sched() const { return se; }
+
+	/*
+	 * Configure and calibrate the chip with
+	 * NAU7802_devConfigure.  Blocks for a few
+	 * seconds.
+	 *
+	 * Return as NAU7802_devConfigure.
+	 */
+	int configure(int gain, uint8_t rate, int ldo){
+		int z = NAU7802_devConfigure(&dev_, gain, rate, ldo);
+		NAU7802_schedInit(&se, dev_.rate, NAU7802_getTimestamp());
+		return z;
+	}
+
+	struct awaiter{
+		sensor &s;
+		std::coroutine_handle<> h;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> c) noexcept {
+			h = c;
+			s.waiter = c;
+		}
+		sample await_resume() const noexcept { return s.last; }
+		/* a task destroyed while waiting must not be resumed */
+		~awaiter(){
+			if(h && s.waiter == h)
+				s.waiter = nullptr;
+		}
+	};
+
+	/*
+	 * Wait for the next conversion.  Only one
+	 * coroutine may wait on a sensor at a time.
+	 */
+	awaiter next_sample(){ return awaiter{*this, nullptr}; }
+
+private:
+	friend class executor;
+	/*
+	 * Read the conversion when CR is set, or recover
+	 * the chip after a failed read or a stall.
+	 *
+	 * Return 1 if last has a new sample, else 0.
+	 */
+	inline int poll();
+
+	executor &ex;
+	sensor *next;
+	struct nau7802_dev dev_;
+	struct sched_entry se;
+	std::coroutine_handle<> waiter;
+	sample last{};
+};
+
+inline int
+sensor::poll(){
+	int32_t raw;
+	int cr, z=0;
+	uint64_t now;
+
+	NAU7802_devLock(&dev_);
+	cr = NAU7802_pollCR(dev_.fd);
+	if(cr == 1 && NAU7802_readRaw(dev_.fd, &raw) == 0){
+		dev_.raw = last.raw = raw;
+		dev_.t_ns = last.t_ns = NAU7802_getTimestamp();
+		dev_.load = last.load = NAU7802_getLoadFromADC(&dev_.lc, raw);
+		NAU7802_schedReady(&se, last.t_ns);
+		z = 1;
+	}
+	else{
+		now = NAU7802_getTimestamp();
+		if(cr != 0 || now - se.read_ns >=
+				executor::stall_periods * se.period_ns){
+			NAU7802_devRecover(&dev_);
+			ex.nrecover++;
+			now = NAU7802_getTimestamp();
+			NAU7802_schedInit(&se, dev_.rate, now);
+		}
+		else
+			NAU7802_schedNotReady(&se, now);
+	}
+	NAU7802_devUnlock(&dev_);
+	return z;
+}
+
+inline void
+executor::run(){
+	struct timespec ts;
+	sensor *s, *first;
+	std::coroutine_handle<> h;
+	uint64_t now;
+
+	running = true;
+	while(running){
+		first = nullptr;
+		for(s = sensors; s; s = s->next)
+			if(s->waiter && (!first || s->se.next_ns < first->se.next_ns))
+				first = s;
+		if(!first)
+			break;
+		now = NAU7802_getTimestamp();
+		if(first->se.next_ns > now){
+			ts.tv_sec = first->se.next_ns / 1000000000ULL;
+			ts.tv_nsec = first->se.next_ns % 1000000000ULL;
+			while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+		}
+		if(!first->poll()){
+			nmiss++;
+			continue;
+		}
+		nread++;
+		h = first->waiter;
+		first->waiter = nullptr;
+		h.resume();
+	}
+	running = false;
+}
+
+} /* namespace nau7802 */
+
+#endif
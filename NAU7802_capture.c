@@ -0,0 +1,201 @@
+/*
+ * Pre-trigger capture buffer.  The acquisition loop pushes
+ * every raw sample into a fixed ring allocated at startup.
+ * A trigger marks a window of pre_ms before and post_ms
+ * after the trigger time; once the window is complete it is
+ * written to a file by NAU7802_serviceCapture, normally from
+ * the writer thread, so acquisition never waits on disk.
+ */
+
+/* include headers */
+#include "NAU7802_capture.h"
+#include "NAU7802.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+/*
+ * Allocate a ring of at least len samples.
+ * len is rounded up to a power of 2.  At
+ * 320 SPS a len of 4096 keeps 12.8 seconds.
+ *
+ * Return 0 on success or -1 on failure.
+ */
+int
+NAU7802_initCapture(struct capture_buf *cb, uint32_t len){
+	uint32_t n=1;
+	memset(cb, 0, sizeof(*cb));
+	if(len == 0 || len > 0x80000000U)
+		return -1;
+	while(n < len)
+		n <<= 1;
+	cb->raw = calloc(n, sizeof(*cb->raw));
+	cb->t_ns = calloc(n, sizeof(*cb->t_ns));
+	if(cb->raw == NULL || cb->t_ns == NULL){
+		NAU7802_freeCapture(cb);
+		return -1;
+	}
+	cb->len = n;
+	atomic_init(&cb->head, 0);
+	atomic_init(&cb->state, CAPTURE_IDLE);
+	atomic_init(&cb->run, 0);
+	return 0;
+}
+
+/*
+ * Release the ring.  Stop the writer
+ * thread first if it was started.
+ */
+void
+NAU7802_freeCapture(struct capture_buf *cb){
+	free(cb->raw);
+	free(cb->t_ns);
+	cb->raw = NULL;
+	cb->t_ns = NULL;
+	cb->len = 0;
+}
+
+/*
+ * Add a sample to the ring.  Called from the acquisition
+ * loop for every sample; does not allocate or block.
+ */
+void
+NAU7802_pushCapture(struct capture_buf *cb, int32_t raw, uint64_t t_ns){
+	uint32_t h, m;
+	m = cb->len - 1;
+	h = atomic_load_explicit(&cb->head, memory_order_relaxed);
+	cb->raw[h & m] = raw;
+	cb->t_ns[h & m] = t_ns;
+	atomic_store_explicit(&cb->head, h + 1, memory_order_release);
+	if(atomic_load_explicit(&cb->state, memory_order_acquire) == CAPTURE_ARMED &&
+		t_ns >= cb->trig_ns + cb->post_ns){
+		cb->end = h + 1;
+		atomic_store_explicit(&cb->state, CAPTURE_READY, memory_order_release);
+	}
+}
+
+/*
+ * Request a snapshot of pre_ms before and post_ms after
+ * now to be written to path.  Safe to call from any
+ * thread, including an event callback.  pre_ms must fit
+ * in the ring at the current sample rate or the oldest
+ * samples will be missing from the snapshot.
+ *
+ * Return 0 on success or -1 if a snapshot is
+ * already pending or an argument is invalid.
+ */
+int
+NAU7802_triggerCapture(struct capture_buf *cb, int pre_ms, int post_ms,
+		const char *path){
+	int idle = CAPTURE_IDLE;
+	if(pre_ms < 0 || post_ms < 0 || path == NULL ||
+		strlen(path) >= CAPTURE_PATH_LEN)
+		return -1;
+	if(!atomic_compare_exchange_strong(&cb->state, &idle, CAPTURE_ARMING))
+		return -1;
+	cb->trig_ns = NAU7802_getTimestamp();
+	cb->pre_ns = (uint64_t)pre_ms * 1000000ULL;
+	cb->post_ns = (uint64_t)post_ms * 1000000ULL;
+	strcpy(cb->path, path);
+	atomic_store_explicit(&cb->state, CAPTURE_ARMED, memory_order_release);
+	return 0;
+}
+
+/*
+ * Write a completed snapshot to its file as lines of
+ * "time_ns_from_trigger raw".  Must not be called from
+ * the acquisition loop.  Samples the ring overwrote while
+ * writing are skipped and counted in cb->lost.
+ *
+ * Return the number of samples written, 0 if no
+ * snapshot is ready or -1 on file error.
+ */
+int
+NAU7802_serviceCapture(struct capture_buf *cb){
+	FILE *fp;
+	uint32_t i, first, h, m;
+	uint64_t t;
+	int32_t raw;
+	int n=0;
+
+	if(atomic_load_explicit(&cb->state, memory_order_acquire) != CAPTURE_READY)
+		return 0;
+	m = cb->len - 1;
+
+	/* walk back to the first sample in the window */
+	first = cb->end;
+	while(first != cb->end - cb->len){
+		t = cb->t_ns[(first - 1) & m];
+		atomic_thread_fence(memory_order_acquire);
+		h = atomic_load_explicit(&cb->head, memory_order_relaxed);
+		/* the writer may have reused the slot during the read */
+		if(h - (first - 1) >= cb->len || t + cb->pre_ns < cb->trig_ns)
+			break;
+		first--;
+	}
+
+	fp = fopen(cb->path, "w");
+	if(fp == NULL){
+		atomic_store_explicit(&cb->state, CAPTURE_IDLE, memory_order_release);
+		return -1;
+	}
+	for(i=first; i!=cb->end; i++){
+		t = cb->t_ns[i & m];
+		raw = cb->raw[i & m];
+		atomic_thread_fence(memory_order_acquire);
+		h = atomic_load_explicit(&cb->head, memory_order_relaxed);
+		/* the writer may have reused the slot during the copy */
+		if(h - i >= cb->len){
+			cb->lost++;
+			continue;
+		}
+		fprintf(fp, "%+" PRId64 " %" PRId32 "\n",
+				(int64_t)(t - cb->trig_ns), raw);
+		n++;
+	}
+	fclose(fp);
+	cb->captures++;
+	atomic_store_explicit(&cb->state, CAPTURE_IDLE, memory_order_release);
+	return n;
+}
+
+static void *
+capture_writer(void *arg){
+	struct capture_buf *cb = arg;
+	while(atomic_load(&cb->run)){
+		NAU7802_serviceCapture(cb);
+		usleep(10000);
+	}
+	NAU7802_serviceCapture(cb);
+	return NULL;
+}
+
+/*
+ * Start a thread that writes completed snapshots
+ * every 10 ms.
+ *
+ * Return 0 on success or -1 on failure.
+ */
+int
+NAU7802_startCaptureWriter(struct capture_buf *cb){
+	atomic_store(&cb->run, 1);
+	if(pthread_create(&cb->writer, NULL, capture_writer, cb) != 0){
+		atomic_store(&cb->run, 0);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Stop the writer thread after it writes
+ * any completed snapshot.
+ */
+void
+NAU7802_stopCaptureWriter(struct capture_buf *cb){
+	if(!atomic_load(&cb->run))
+		return;
+	atomic_store(&cb->run, 0);
+	pthread_join(cb->writer, NULL);
+}
@@ -0,0 +1,54 @@
+/*
+ * Header for the pre-trigger capture buffer.  Raw samples
+ * are always kept in a ring so that a trigger can save the
+ * samples from before and after a fault to a file.
+ */
+
+#ifndef NAU7802_CAPTURE_H
+#define NAU7802_CAPTURE_H
+
+/* include headers */
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* define macros */
+#define CAPTURE_IDLE 0		/* no trigger pending */
+#define CAPTURE_ARMING 1	/* trigger being set up */
+#define CAPTURE_ARMED 2		/* waiting for post trigger samples */
+#define CAPTURE_READY 3		/* window complete, waiting to be written */
+#define CAPTURE_PATH_LEN 256
+
+struct capture_buf{
+	uint32_t len;		/* ring length, power of 2 */
+	int32_t *raw;		/* raw ADC values */
+	uint64_t *t_ns;		/* CLOCK_MONOTONIC time of each sample */
+	atomic_uint head;	/* samples pushed */
+	atomic_int state;	/* CAPTURE_IDLE .. CAPTURE_READY */
+	uint64_t trig_ns;	/* time of trigger */
+	uint64_t pre_ns;	/* time kept before trigger */
+	uint64_t post_ns;	/* time kept after trigger */
+	uint32_t end;		/* head when the window completed */
+	char path[CAPTURE_PATH_LEN];	/* file for the snapshot */
+	uint32_t captures;	/* snapshots written */
+	uint32_t lost;		/* samples overwritten before written */
+	pthread_t writer;	/* optional writer thread */
+	atomic_int run;		/* writer thread running */
+};
+
+int NAU7802_initCapture(struct capture_buf *cb, uint32_t len);
+
+void NAU7802_freeCapture(struct capture_buf *cb);
+
+void NAU7802_pushCapture(struct capture_buf *cb, int32_t raw, uint64_t t_ns);
+
+int NAU7802_triggerCapture(struct capture_buf *cb, int pre_ms, int post_ms,
+		const char *path);
+
+int NAU7802_serviceCapture(struct capture_buf *cb);
+
+int NAU7802_startCaptureWriter(struct capture_buf *cb);
+
+void NAU7802_stopCaptureWriter(struct capture_buf *cb);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Compile time configured NAU7802 for C++20.
+ *
+ * The gain, conversion rate, LDO voltage and bits shifted
+ * out are template arguments, so the register images and
+ * conversion constants are computed by the compiler and an
+ * invalid setting fails to compile instead of returning -1
+ * from NAU7802_setGain, NAU7802_setLDO or
+ * NAU7802_setSampleRate.  Configuring writes the images
+ * whole, and the read and convert path has no branches.
+ * The C API in NAU7802.h is unchanged.
+ *
+ *	nau7802::Nau7802<nau7802::Gain::x128, nau7802::Rate::sps320,
+ *		nau7802::Ldo::v3_0> s("/dev/i2c-1");
+ *	s.configure();
+ *	s.setCal(0.25, 0.0);
+ *	for(;;){
+ *		while(!s.ready());
+ *		printf("%f\n", s.readLoad());
+ *	}
+ *
+ * Compile g++ with -std=c++20.
+ */
+
+#ifndef NAU7802_CONFIG_HPP
+#define NAU7802_CONFIG_HPP
+
+/* include headers */
+#include "NAU7802.h"
+#include <chrono>
+#include <cstdint>
+#include <unistd.h>
+
+namespace nau7802 {
+
+/* PGA gain, value is the CTRL1 bits 2:0 */
+enum class Gain : uint8_t {
+	x1 = 0, x2, x4, x8, x16, x32, x64, x128
+};
+
+/* conversion rate, value is the CTRL2 CRS bits 6:4 */
+enum class Rate : uint8_t {
+	sps10 = CRS_10, sps20 = CRS_20, sps40 = CRS_40,
+	sps80 = CRS_80, sps320 = CRS_320
+};
+
+/* LDO voltage, value is the CTRL1 VLDO bits 5:3 */
+enum class Ldo : uint8_t {
+	v4_5 = V4_5, v4_2 = V4_2, v3_9 = V3_9, v3_6 = V3_6,
+	v3_3 = V3_3, v3_0 = V3_0, v2_7 = V2_7, v2_4 = V2_4
+};
+
+constexpr bool
+validRate(Rate r){
+	return r == Rate::sps10 || r == Rate::sps20 || r == Rate::sps40 ||
+		r == Rate::sps80 || r == Rate::sps320;
+}
+
+constexpr int
+rateSPS(Rate r){
+	return r == Rate::sps10 ? 10 : r == Rate::sps20 ? 20 :
+		r == Rate::sps40 ? 40 : r == Rate::sps80 ? 80 : 320;
+}
+
+/* LDO output in millivolts */
+constexpr int
+ldoMillivolts(Ldo l){
+	return 4500 - 300 * static_cast<int>(l);
+}
+
+template<Gain G, Rate R, Ldo L, uint8_t Shift = 0>
+class Nau7802{
+	static_assert(static_cast<uint8_t>(G) <= 7, "gain must be 1-128 in powers of 2");
+	static_assert(validRate(R), "rate must be 10, 20, 40, 80 or 320 SPS");
+	static_assert(static_cast<uint8_t>(L) <= 7, "LDO must be 2.4-4.5 V");
+	static_assert(Shift < 24, "shift must leave at least one ADC bit");
+
+public:
+	/* register images written by configure */
+	static constexpr uint8_t pu_ctrl = (1 << PUD) | (1 << PUA) |
+		(1 << CS) | (AVDD_INT << AVDDS);
+	static constexpr uint8_t ctrl1 = static_cast<uint8_t>(L) << 3 |
+		static_cast<uint8_t>(G);
+	static constexpr uint8_t ctrl2 = static_cast<uint8_t>(R) << 4;
+	static constexpr uint8_t ctrl2_cal = ctrl2 | (1 << CALS) | CALMOD_GCS;
+
+	static constexpr int gain = 1 << static_cast<uint8_t>(G);
+	static constexpr int sps = rateSPS(R);
+	static constexpr uint64_t period_ns = 1000000000ULL / sps;
+	/* input volts per count after the shift, full scale is +-0.5*VLDO/gain */
+	static constexpr double volts_per_count = 0.5 * ldoMillivolts(L) / 1000.0 /
+		gain / (double)(1 << (23 - Shift));
+
+	explicit Nau7802(const char *bus, int addr = NAU7802_ADDR){
+		fd_ = bus ? wiringPiI2CSetupInterface(bus, addr) : wiringPiI2CSetup(addr);
+	}
+
+	~Nau7802(){
+		if(fd_ >= 0)
+			close(fd_);
+	}
+
+	Nau7802(const Nau7802 &) = delete;
+	Nau7802 &operator=(const Nau7802 &) = delete;
+
+	/* fd for the functions in NAU7802.h, -1 if open failed */
+	int fd() const { return fd_; }
+
+	/*
+	 * Reset the chip, write the register images and
+	 * calibrate, retrying like NAU7802_devCalibrate.
+	 * Blocks for a few seconds.
+	 *
+	 * Return 0 on success, -1 on power up failure,
+	 * -2 if a register did not read back as written,
+	 * -3 if calibration did not finish in NAU7802_CAL_NS
+	 * or a read failed, or the CAL_ERR bit if
+	 * calibration failed.
+	 */
+	int configure(){
+		std::chrono::steady_clock::time_point deadline;
+		int r, z, i=0;
+		wiringPiI2CWriteReg8(fd_, PU_CTRL, RESET);
+		wiringPiI2CWriteReg8(fd_, PU_CTRL, NORMAL_OP);
+		delay(200);
+		if(!(wiringPiI2CReadReg8(fd_, PU_CTRL) & (1 << PUR)))
+			return -1;
+		wiringPiI2CWriteReg8(fd_, PU_CTRL, pu_ctrl);
+		wiringPiI2CWriteReg8(fd_, CTRL1, ctrl1);
+		wiringPiI2CWriteReg8(fd_, CTRL2, ctrl2);
+		if((wiringPiI2CReadReg8(fd_, CTRL1) & 0x3F) != ctrl1 ||
+			(wiringPiI2CReadReg8(fd_, CTRL2) & 0x70) != ctrl2)
+			return -2;
+		delay(2000);
+		do{
+			wiringPiI2CWriteReg8(fd_, CTRL2, ctrl2_cal);
+			deadline = std::chrono::steady_clock::now() +
+				std::chrono::nanoseconds(NAU7802_CAL_NS);
+			while((r = wiringPiI2CReadReg8(fd_, CTRL2)) >= 0 &&
+				(r & (1 << CALS)) &&
+				std::chrono::steady_clock::now() < deadline);
+			if(r < 0 || (r & (1 << CALS)))
+				z = -3;
+			else
+				z = (r >> CAL_ERR) & 1;
+			++i;
+			delay(200);
+		}while(z && i<10);
+		delay(1000);
+		return z;
+	}
+
+	/*
+	 * Set the load calibration.  zero has the
+	 * software offset of load_cal already removed.
+	 */
+	void setCal(double g, double zero){
+		cal_gain = g;
+		cal_zero = zero;
+	}
+
+	/*
+	 * Take the gain, zero and offset of a load_cal.
+	 * Its shift must match the template Shift.
+	 *
+	 * Return 0 or -1 if the shift differs.
+	 */
+	int setCal(const struct load_cal &lc){
+		if(lc.shift != Shift)
+			return -1;
+		setCal(lc.gain, lc.zero - lc.offset);
+		return 0;
+	}
+
+	/* Return the CR bit, 0 if the read failed. */
+	int ready() const {
+		int r = wiringPiI2CReadReg8(fd_, PU_CTRL);
+		return r >= 0 && ((r >> CR) & 1);
+	}
+
+	/* Return the raw ADC value with Shift bits shifted out. */
+	int32_t readRaw() const {
+		uint32_t adc;
+		adc = (uint32_t)wiringPiI2CReadReg8(fd_, ADCO_B2) << 24;
+		adc |= (uint32_t)wiringPiI2CReadReg8(fd_, ADCO_B1) << 16;
+		adc |= (uint32_t)wiringPiI2CReadReg8(fd_, ADCO_B0) << 8;
+		return (int32_t)adc >> (8 + Shift);
+	}
+
+	/* Return the load of a value from readRaw. */
+	double load(int32_t raw) const {
+		return raw * cal_gain + cal_zero;
+	}
+
+	/* Return the input voltage of a value from readRaw. */
+	static constexpr double volts(int32_t raw){
+		return raw * volts_per_count;
+	}
+
+	/* Return the load of the current conversion. */
+	double readLoad() const {
+		return load(readRaw());
+	}
+
+private:
+	int fd_;
+	double cal_gain = 1.0;
+	double cal_zero = 0.0;
+};
+
+} /* namespace nau7802 */
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Block conversion of raw ADC values to load.  The float
+ * path uses NEON or SSE2 when the compiler targets them and
+ * plain C otherwise; the fixed path needs only a 32 by 32 bit
+ * multiply with a 64 bit result, which ARMv6 has, and no
+ * floating point at all.  See NAU7802_conv.h for the error
+ * bounds of both.
+ */
+
+/* include headers */
+#include "NAU7802_conv.h"
+#include <math.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CONV_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CONV_SSE2
+#endif
+
+/*
+ * Precompute the float and fixed constants of a
+ * load_cal.  Fixed results have frac fraction bits,
+ * e.g. frac=8 gives load in 1/256 units.  The most
+ * multiplier bits that fit 32 bits are used.  Must
+ * be called again after the load_cal changes.
+ *
+ * Return 0 or -1 if gain * 2^frac does not fit
+ * 32 bits or zero * 2^frac does not fit 63 bits.
+ */
+int
+NAU7802_convInit(struct conv_cal *cv, struct load_cal *lc, int frac){
+	double zero, range;
+	int q;
+
+	zero = lc->zero - lc->offset;
+	cv->shift = lc->shift;
+	cv->gain = (float)lc->gain;
+	cv->zero = (float)zero;
+	cv->frac = frac;
+	if(frac < 0 || frac > 30)
+		return -1;
+	for(q=CONV_MAX_Q; q>=0; q--)
+		if(fabs(lc->gain) * ldexp(1.0, q + frac) < 2147483647.0)
+			break;
+	if(q < 0 || fabs(zero) * ldexp(1.0, q + frac) >= ldexp(1.0, 62))
+		return -1;
+	cv->q = q;
+	cv->mul = (int32_t)lrint(ldexp(lc->gain, q + frac));
+	cv->bias = (int64_t)llrint(ldexp(zero, q + frac));
+	if(q > 0)
+		cv->bias += (int64_t)1 << (q - 1);	/* round to nearest */
+
+	range = ldexp(1.0, 23 - cv->shift);
+	cv->float_err = (3.0 * fabs(lc->gain) * range + 2.0 * fabs(zero)) *
+		ldexp(1.0, -24);
+	cv->fixed_err = (range / 2.0 + 1.0) * ldexp(1.0, -(q + frac)) +
+		ldexp(1.0, -(frac + 1));
+	return 0;
+}
+
+/*
+ * Convert n raw values to load in float, four at
+ * a time with NEON or SSE2 where available.
+ */
+void
+NAU7802_convFloat(const struct conv_cal *cv, const int32_t *raw,
+		float *load, int n){
+	int i=0;
+#if defined(CONV_NEON)
+	int32x4_t sh = vdupq_n_s32(-cv->shift);
+	float32x4_t g = vdupq_n_f32(cv->gain);
+	float32x4_t z = vdupq_n_f32(cv->zero);
+	float32x4_t x;
+	for(; i+4<=n; i+=4){
+		x = vcvtq_f32_s32(vshlq_s32(vld1q_s32(raw + i), sh));
+		vst1q_f32(load + i, vmlaq_f32(z, x, g));
+	}
+#elif defined(CONV_SSE2)
+	__m128i sh = _mm_cvtsi32_si128(cv->shift);
+	__m128 g = _mm_set1_ps(cv->gain);
+	__m128 z = _mm_set1_ps(cv->zero);
+	__m128 x;
+	for(; i+4<=n; i+=4){
+		x = _mm_cvtepi32_ps(_mm_sra_epi32(
+				_mm_loadu_si128((const __m128i *)(raw + i)), sh));
+		_mm_storeu_ps(load + i, _mm_add_ps(_mm_mul_ps(x, g), z));
+	}
+#endif
+	for(; i<n; i++)
+		load[i] = (raw[i] >> cv->shift) * cv->gain + cv->zero;
+}
+
+/*
+ * Convert n raw values to load with cv->frac
+ * fraction bits using integers only.
+ */
+void
+NAU7802_convFixed(const struct conv_cal *cv, const int32_t *raw,
+		int32_t *load, int n){
+	const int32_t mul = cv->mul;
+	const int64_t bias = cv->bias;
+	const int shift = cv->shift, q = cv->q;
+	int i;
+	for(i=0; i<n; i++)
+		load[i] = (int32_t)(((int64_t)(raw[i] >> shift) * mul + bias) >> q);
+}
+
+/*
+ * Name the float path that was compiled in.
+ *
+ * Return "neon", "sse2" or "scalar".
+ */
+const char *
+NAU7802_convPath(void){
+#if defined(CONV_NEON)
+	return "neon";
+#elif defined(CONV_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
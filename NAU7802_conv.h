@@ -0,0 +1,60 @@
+/*
+ * Header for block conversion of raw ADC values to load in
+ * float or fixed point, for CPUs where double is slow.
+ *
+ * Error against NAU7802_getLoadFromADC, for raw values of
+ * at most 24 bits, is bounded by the values NAU7802_convInit
+ * puts in float_err and fixed_err:
+ *
+ * float	(3 |gain| R + 2 |zero|) 2^-24, from rounding gain,
+ *		zero, the product and the sum to float, where
+ *		R = 2^23 >> shift and zero has the offset removed.
+ * fixed	(R / 2 + 1) 2^-(q + frac) + 2^-(frac + 1) load, from
+ *		rounding the multiplier and bias to q + frac bits
+ *		and the result to frac bits.
+ *
+ * Results of the fixed path that do not fit in int32_t
+ * are not defined; choose frac so |load| 2^frac < 2^31.
+ */
+
+#ifndef NAU7802_CONV_H
+#define NAU7802_CONV_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define CONV_MAX_Q 40		/* most fraction bits of the fixed multiplier */
+
+struct conv_cal{
+	int shift;		/* bits shifted out of raw */
+	float gain;		/* load per count */
+	float zero;		/* zero minus offset */
+	int32_t mul;		/* gain in Q(q + frac) */
+	int64_t bias;		/* zero minus offset in Q(q + frac), plus rounding */
+	int q;			/* bits dropped after the multiply */
+	int frac;		/* fraction bits of fixed results */
+	double float_err;	/* largest error of NAU7802_convFloat */
+	double fixed_err;	/* largest error of NAU7802_convFixed */
+};
+
+int NAU7802_convInit(struct conv_cal *cv, struct load_cal *lc, int frac);
+
+void NAU7802_convFloat(const struct conv_cal *cv, const int32_t *raw,
+		float *load, int n);
+
+void NAU7802_convFixed(const struct conv_cal *cv, const int32_t *raw,
+		int32_t *load, int n);
+
+const char *NAU7802_convPath(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
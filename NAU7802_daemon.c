@@ -0,0 +1,82 @@
+/*
+ * Daemon that owns one NAU7802 and streams its samples to
+ * local clients over a Unix domain socket, so several
+ * consumers share one reader of the I2C device.
+ *
+ * ./nau7802d [bus [socket [stats_file]]]
+ * ./nau7802d /dev/i2c-1 /tmp/nau7802.sock /tmp/nau7802.stats
+ *
+ * With a stats file the I2C and sample counters are appended
+ * to it every DAEMON_STATS_MS.
+ */
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_dev.h"
+#include "NAU7802_stream.h"
+#include "NAU7802_server.h"
+#include "NAU7802_stats.h"
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define DAEMON_STATS_MS 10000
+
+static struct nau7802_dev dev;
+static struct nau7802_stream st;
+static struct nau7802_server srv;
+static struct stats_dump sd;
+static volatile sig_atomic_t done = 0;
+
+static void
+stop(int sig){
+	done = 1;
+}
+
+int
+main(int argc, char **argv){
+	const char *bus = DEV_DEFAULT_BUS;
+	const char *path = SERVER_PATH;
+	int z;
+
+	if(argc >= 2)
+		bus = argv[1];
+	if(argc >= 3)
+		path = argv[2];
+	if(NAU7802_devOpen(&dev, bus, NAU7802_ADDR) == -1){
+		printf("Open Failed : %s\n", bus ? bus : "default bus");
+		return 1;
+	}
+	if((z = NAU7802_devConfigure(&dev, 128, CRS_320, V3_0)) != 0)
+		printf("Configure Failed : %d\n", z);
+	NAU7802_setLoadCalGain(&dev.lc, 0.25);
+	NAU7802_setShiftLoad(&dev.lc, 0);
+	NAU7802_devTareLoad(&dev);
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	if(NAU7802_streamStart(&st, &dev) == -1){
+		printf("Stream start failed\n");
+		return 1;
+	}
+	if(NAU7802_serverStart(&srv, &st, path) == -1){
+		printf("Server start failed : %s\n", path);
+		NAU7802_streamStop(&st);
+		return 1;
+	}
+	printf("Streaming on %s\n", path);
+	if(argc >= 4){
+		if(NAU7802_statsDumpStart(&sd, argv[3], DAEMON_STATS_MS) == -1)
+			printf("Stats dump failed : %s\n", argv[3]);
+		else
+			NAU7802_statsDumpAdd(&sd, bus ? bus : "default", &dev.stats);
+	}
+	while(!done)
+		pause();
+	if(argc >= 4)
+		NAU7802_statsDumpStop(&sd);
+	NAU7802_serverStop(&srv);
+	NAU7802_streamStop(&st);
+	NAU7802_devClose(&dev);
+	return 0;
+}
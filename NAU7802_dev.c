@@ -0,0 +1,382 @@
+/*
+ * NAU7802 device handle.  Every function locks the handle
+ * so a handle can be shared between threads, and separate
+ * handles never share state.  The lock is recursive so a
+ * caller may hold it across several calls, for example to
+ * use dev->fd with the functions in NAU7802.c directly.
+ *
+ * Each handle has its own I2C and sample counters, bound to
+ * the thread holding the lock, so chips sharing one fd behind
+ * a mux are counted apart.
+ *
+ * The handle caches the settings and calibration registers,
+ * so NAU7802_devRecover can bring a chip back after a reset
+ * or a bus fault in tens of ms instead of the seconds of
+ * delays and calibration NAU7802_devConfigure takes.
+ */
+
+/* include headers */
+#include "NAU7802_dev.h"
+#include "NAU7802_shm.h"
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Open the NAU7802 at addr on an I2C bus such as
+ * "/dev/i2c-1".  Use DEV_DEFAULT_BUS for the bus
+ * wiringPiI2CSetup would pick.  The chip is not touched,
+ * use NAU7802_devConfigure to set it up.
+ *
+ * Return the fd or -1 on failure.
+ */
+int
+NAU7802_devOpen(struct nau7802_dev *dev, const char *bus, int addr){
+	int fd;
+	if(bus != NULL && strlen(bus) >= DEV_BUS_LEN)
+		return -1;
+	if(bus == NULL)
+		fd = wiringPiI2CSetup(addr);
+	else
+		fd = wiringPiI2CSetupInterface(bus, addr);
+	if(fd < 0)
+		return -1;
+	NAU7802_devAttach(dev, fd);
+	dev->own_fd = 1;
+	dev->addr = addr;
+	if(bus != NULL)
+		strcpy(dev->bus, bus);
+	return fd;
+}
+
+/*
+ * Set up a handle for an fd that is already open,
+ * for example several chips reached through one
+ * bus fd behind a mux.  The fd is not closed by
+ * NAU7802_devClose.
+ *
+ * Return the fd.
+ */
+int
+NAU7802_devAttach(struct nau7802_dev *dev, int fd){
+	pthread_mutexattr_t attr;
+	memset(dev, 0, sizeof(*dev));
+	dev->fd = fd;
+	dev->addr = NAU7802_ADDR;
+	NAU7802_init_load_cal(&dev->lc);
+	/* power on defaults */
+	dev->gain = 1;
+	dev->rate = CRS_10;
+	dev->ldo = V4_5;
+	dev->avdd = AVDD_PIN;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&dev->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return fd;
+}
+
+/*
+ * Close the log and the fd if the handle owns it.
+ */
+void
+NAU7802_devClose(struct nau7802_dev *dev){
+	NAU7802_devLock(dev);
+	if(dev->log_fd > 0)
+		close(dev->log_fd);
+	dev->log_fd = 0;
+	if(dev->own_fd && dev->fd >= 0)
+		close(dev->fd);
+	dev->fd = -1;
+	NAU7802_devUnlock(dev);
+	pthread_mutex_destroy(&dev->lock);
+}
+
+/*
+ * Take the handle lock.  Until it is released the
+ * calling thread counts into dev->stats, see
+ * NAU7802_bindStats.
+ */
+void
+NAU7802_devLock(struct nau7802_dev *dev){
+	pthread_mutex_lock(&dev->lock);
+	if(dev->lock_depth++ == 0)
+		dev->prev_stats = NAU7802_bindStats(&dev->stats);
+}
+
+/*
+ * Release the handle lock.
+ */
+void
+NAU7802_devUnlock(struct nau7802_dev *dev){
+	if(--dev->lock_depth == 0)
+		NAU7802_bindStats(dev->prev_stats);
+	pthread_mutex_unlock(&dev->lock);
+}
+
+/*
+ * Reset, power up and configure the chip the same
+ * way init_sensor does, then calibrate.  gain is 1-128,
+ * rate and ldo are the CRS_ and V macros.  The settings
+ * are kept in the handle.
+ *
+ * Return 0 on success, -1 on power up failure,
+ * -2 on enable failure, -3 on invalid setting or
+ * the CAL_ERR bit if calibration failed.
+ */
+int
+NAU7802_devConfigure(struct nau7802_dev *dev, int gain, uint8_t rate, int ldo){
+	int z=0;
+	NAU7802_devLock(dev);
+	if(NAU7802_init(dev->fd) != 1)
+		z = -1;
+	delay(200);
+	if(z == 0 && NAU7802_enable(dev->fd) != 1)
+		z = -2;
+	delay(200);
+	if(z == 0 && NAU7802_setGain(dev->fd, gain) == -1)
+		z = -3;
+	if(z == 0 && NAU7802_AVDDSourceSelect(dev->fd, AVDD_INT) == -1)
+		z = -3;
+	if(z == 0 && NAU7802_setLDO(dev->fd, ldo) < 0)
+		z = -3;
+	if(z == 0 && NAU7802_setSampleRate(dev->fd, rate) == -1)
+		z = -3;
+	if(z == 0){
+		dev->gain = gain;
+		dev->rate = rate;
+		dev->ldo = ldo;
+		dev->avdd = AVDD_INT;
+		delay(2000);
+		z = NAU7802_devCalibrate(dev);
+	}
+	NAU7802_devUnlock(dev);
+	return z;
+}
+
+/*
+ * Run the system gain calibration, retrying up
+ * to 10 times like calibrate_sensor, and cache
+ * the calibration registers.
+ *
+ * Return CAL_ERR bit. 1=ERROR, 0=NO ERROR.
+ */
+int
+NAU7802_devCalibrate(struct nau7802_dev *dev){
+	int z, i=0;
+	NAU7802_devLock(dev);
+	do{
+		z = NAU7802_calibrate(dev->fd, CALMOD_GCS);
+		++i;
+		delay(200);
+	}while(z && i<10);
+	delay(1000);
+	dev->cal_valid = z == 0 &&
+		NAU7802_readCal(dev->fd, 1, &dev->ocal, &dev->gcal) == 0;
+	NAU7802_devUnlock(dev);
+	return z;
+}
+
+/*
+ * Bring the chip back after a reset, brown out or
+ * bus fault: reopen the fd if the handle owns it,
+ * keeping its number so threads that poll without
+ * the lock never see it closed or changed, reset
+ * and power up the chip, write back the settings
+ * and cached calibration, and wait for a settled
+ * conversion.  The deadline is the time
+ * DEV_RECOVER_DISCARD + 2 conversions take at the
+ * handle rate after DEV_RECOVER_SETTLE_NS, but at
+ * least DEV_RECOVER_NS, so slow rates can recover.
+ * The chip is not calibrated, so without a cached
+ * calibration use NAU7802_devCalibrate afterwards.
+ *
+ * Return 0 on success, -1 if the fd could not be
+ * reopened, -2 if the chip did not power up, -3 if
+ * a setting could not be written or -4 if no
+ * conversion came in time.
+ */
+int
+NAU7802_devRecover(struct nau7802_dev *dev){
+	uint64_t t0, deadline;
+	int32_t raw;
+	int fd, i, z=0;
+
+	NAU7802_devLock(dev);
+	t0 = NAU7802_getTimestamp();
+	deadline = (DEV_RECOVER_DISCARD + 2) * NAU7802_ratePeriod(dev->rate) +
+		DEV_RECOVER_SETTLE_NS;
+	if(deadline < DEV_RECOVER_NS)
+		deadline = DEV_RECOVER_NS;
+	deadline += t0;
+	if(dev->own_fd){
+		if(dev->bus[0] == '\0')
+			fd = wiringPiI2CSetup(dev->addr);
+		else
+			fd = wiringPiI2CSetupInterface(dev->bus, dev->addr);
+		if(fd < 0)
+			z = -1;
+		else if(dev->fd < 0)
+			dev->fd = fd;
+		else{
+			/* swap the new file in under the old number */
+			if(dup2(fd, dev->fd) == -1)
+				z = -1;
+			close(fd);
+		}
+	}
+	/* PUR is normally set 200 us after the reset */
+	while(z == 0 && NAU7802_init(dev->fd) != 1)
+		if(NAU7802_getTimestamp() >= deadline)
+			z = -2;
+	if(z == 0 && NAU7802_enable(dev->fd) != 1)
+		z = -2;
+	if(z == 0 && (NAU7802_setGain(dev->fd, dev->gain) == -1 ||
+		NAU7802_AVDDSourceSelect(dev->fd, dev->avdd) == -1 ||
+		(dev->avdd == AVDD_INT && NAU7802_setLDO(dev->fd, dev->ldo) < 0) ||
+		NAU7802_setSampleRate(dev->fd, dev->rate) == -1 ||
+		(dev->cal_valid &&
+		 NAU7802_writeCal(dev->fd, 1, dev->ocal, dev->gcal) == -1)))
+		z = -3;
+	for(i=0; z == 0 && i<=DEV_RECOVER_DISCARD; i++)
+		if(NAU7802_waitCR(dev->fd, deadline) != 1 ||
+			NAU7802_readRaw(dev->fd, &raw) == -1)
+			z = -4;
+	if(z == 0){
+		dev->recover_last_ns = NAU7802_getTimestamp() - t0;
+		dev->recover_sum_ns += dev->recover_last_ns;
+		if(dev->recover_last_ns > dev->recover_max_ns)
+			dev->recover_max_ns = dev->recover_last_ns;
+		dev->recoveries++;
+	}
+	else
+		dev->recover_fails++;
+	NAU7802_devUnlock(dev);
+	return z;
+}
+
+/*
+ * Wait for the next conversion and read it
+ * as a load.  The sample is kept in the handle
+ * and published if NAU7802_devPublish was used.
+ * If no conversion comes before NAU7802_deadline
+ * or a read fails the chip is recovered once with
+ * NAU7802_devRecover.  A read that still fails is
+ * published with SHM_ERROR and the last values.
+ *
+ * Returns load value or DBL_MAX on failure, which
+ * is no sample: do not convert or average it.
+ */
+double
+NAU7802_devReadLoad(struct nau7802_dev *dev){
+	int32_t raw;
+	double load;
+	NAU7802_devLock(dev);
+	if((NAU7802_waitCR(dev->fd, NAU7802_deadline(dev->fd)) != 1 ||
+		NAU7802_readRaw(dev->fd, &raw) == -1) &&
+		(NAU7802_devRecover(dev) != 0 ||
+		 NAU7802_waitCR(dev->fd, NAU7802_deadline(dev->fd)) != 1 ||
+		 NAU7802_readRaw(dev->fd, &raw) == -1)){
+		if(dev->shm)
+			NAU7802_shmPublish(dev->shm, dev->shm_index, dev->raw,
+				dev->load, dev->filtered, dev->t_ns, SHM_ERROR);
+		NAU7802_devUnlock(dev);
+		return DBL_MAX;
+	}
+	dev->raw = raw;
+	dev->t_ns = NAU7802_getTimestamp();
+	load = dev->load = NAU7802_getLoadFromADC(&dev->lc, dev->raw);
+	if(dev->shm)
+		NAU7802_shmPublish(dev->shm, dev->shm_index, dev->raw,
+			dev->load, dev->filtered, dev->t_ns, 0);
+	NAU7802_devUnlock(dev);
+	return load;
+}
+
+/*
+ * Read n conversions into out with NAU7802_readSamples.
+ * The handle stays locked for the whole block, so other
+ * users of the handle wait up to n conversions.  The
+ * last sample is kept and published like
+ * NAU7802_devReadLoad.
+ *
+ * Return the number of samples read.
+ */
+int
+NAU7802_devReadSamples(struct nau7802_dev *dev, int n, struct sample_block *out){
+	NAU7802_devLock(dev);
+	n = NAU7802_readSamples(dev->fd, n, out);
+	if(n > 0){
+		dev->raw = out->raw[n - 1];
+		dev->t_ns = out->t_ns[n - 1];
+		dev->load = NAU7802_getLoadFromADC(&dev->lc, dev->raw);
+		if(dev->shm)
+			NAU7802_shmPublish(dev->shm, dev->shm_index, dev->raw,
+				dev->load, dev->filtered, dev->t_ns,
+				(out->status[n - 1] & SAMPLE_IO_ERR) ? SHM_ERROR : 0);
+	}
+	NAU7802_devUnlock(dev);
+	return n;
+}
+
+/*
+ * Add a value to the moving average of the
+ * last DEV_AVG_LEN values.  The average is
+ * published as the filtered load.  DBL_MAX
+ * from a failed read is not added.
+ *
+ * Return the average, DBL_MAX while it has
+ * no values.
+ */
+double
+NAU7802_devAverageLoad(struct nau7802_dev *dev, double value){
+	double sum=0.0;
+	int i;
+	NAU7802_devLock(dev);
+	if(value == DBL_MAX){
+		value = dev->avg_count ? dev->filtered : DBL_MAX;
+		NAU7802_devUnlock(dev);
+		return value;
+	}
+	dev->avg[dev->avg_index] = value;
+	dev->avg_index++;
+	if(dev->avg_index >= DEV_AVG_LEN)
+		dev->avg_index = 0;
+	if(dev->avg_count < DEV_AVG_LEN)
+		dev->avg_count++;
+	for(i=0; i<dev->avg_count; i++)
+		sum += dev->avg[i];
+	value = dev->filtered = sum / dev->avg_count;
+	if(dev->shm)
+		NAU7802_shmPublish(dev->shm, dev->shm_index, dev->raw,
+			dev->load, dev->filtered, dev->t_ns, 0);
+	NAU7802_devUnlock(dev);
+	return value;
+}
+
+/*
+ * Tare the load as NAU7802_tareLoad does.
+ *
+ * Returns the difference of the old offset and
+ * new offset or DBL_MAX on error.
+ */
+double
+NAU7802_devTareLoad(struct nau7802_dev *dev){
+	double z;
+	NAU7802_devLock(dev);
+	z = NAU7802_tareLoad(dev->fd, &dev->lc);
+	NAU7802_devUnlock(dev);
+	return z;
+}
+
+/*
+ * Publish every sample of the handle to slot index
+ * of a region from NAU7802_shmCreate.  Use NULL to
+ * stop publishing.
+ */
+void
+NAU7802_devPublish(struct nau7802_dev *dev, struct shm_region *shm, int index){
+	NAU7802_devLock(dev);
+	dev->shm = shm;
+	dev->shm_index = index;
+	NAU7802_devUnlock(dev);
+}
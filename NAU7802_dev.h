@@ -0,0 +1,93 @@
+/*
+ * Header for the NAU7802 device handle.  A handle owns
+ * everything that used to be static state so one process
+ * can drive several sensors from several threads.
+ */
+
+#ifndef NAU7802_DEV_H
+#define NAU7802_DEV_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct shm_region;
+
+/* define macros */
+#define DEV_AVG_LEN 10		/* moving average length */
+#define DEV_BUS_LEN 32		/* length of I2C bus device name */
+#define DEV_DEFAULT_BUS NULL	/* use the wiringPi default bus */
+#define DEV_RECOVER_NS 100000000ULL	/* shortest recovery deadline, 100 ms */
+#define DEV_RECOVER_DISCARD 1	/* conversions discarded after a recovery */
+#define DEV_RECOVER_SETTLE_NS 20000000ULL	/* power up before the first conversion */
+
+struct nau7802_dev{
+	int fd;			/* I2C file descriptor */
+	int own_fd;		/* 1 if fd is closed by NAU7802_devClose */
+	int addr;		/* I2C address */
+	char bus[DEV_BUS_LEN];	/* I2C bus device or "" for default */
+	struct load_cal lc;	/* load calibration */
+	double avg[DEV_AVG_LEN];	/* moving average samples */
+	unsigned int avg_index;	/* next sample to replace */
+	int avg_count;		/* samples in average */
+	int log_fd;		/* log file, 0 when not open */
+	int gain;		/* shadow of PGA gain 1-128 */
+	uint8_t rate;		/* shadow of CRS rate macro */
+	int ldo;		/* shadow of LDO voltage macro */
+	int avdd;		/* shadow of AVDD source macro */
+	int32_t raw;		/* last raw ADC value */
+	double load;		/* last load */
+	double filtered;	/* last moving average */
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of last read */
+	struct shm_region *shm;	/* shared memory to publish to or NULL */
+	int shm_index;		/* sensor slot in shm */
+	int32_t ocal;		/* cached CH1 offset calibration register */
+	uint32_t gcal;		/* cached CH1 gain calibration register */
+	int cal_valid;		/* 1 when ocal and gcal are cached */
+	uint32_t recoveries;	/* successful NAU7802_devRecover calls */
+	uint32_t recover_fails;	/* failed NAU7802_devRecover calls */
+	uint64_t recover_last_ns;	/* duration of the last recovery */
+	uint64_t recover_max_ns;	/* longest recovery */
+	uint64_t recover_sum_ns;	/* time spent recovering */
+	struct nau7802_stats stats;	/* I2C and sample counters */
+	struct nau7802_stats *prev_stats;	/* bound before the lock was taken */
+	int lock_depth;		/* recursive lock count of the owner */
+	pthread_mutex_t lock;	/* serializes access to the device */
+};
+
+int NAU7802_devOpen(struct nau7802_dev *dev, const char *bus, int addr);
+
+int NAU7802_devAttach(struct nau7802_dev *dev, int fd);
+
+void NAU7802_devClose(struct nau7802_dev *dev);
+
+void NAU7802_devLock(struct nau7802_dev *dev);
+
+void NAU7802_devUnlock(struct nau7802_dev *dev);
+
+int NAU7802_devConfigure(struct nau7802_dev *dev, int gain, uint8_t rate, int ldo);
+
+int NAU7802_devCalibrate(struct nau7802_dev *dev);
+
+int NAU7802_devRecover(struct nau7802_dev *dev);
+
+double NAU7802_devReadLoad(struct nau7802_dev *dev);
+
+int NAU7802_devReadSamples(struct nau7802_dev *dev, int n, struct sample_block *out);
+
+double NAU7802_devAverageLoad(struct nau7802_dev *dev, double value);
+
+double NAU7802_devTareLoad(struct nau7802_dev *dev);
+
+void NAU7802_devPublish(struct nau7802_dev *dev, struct shm_region *shm, int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Conversion clock drift estimation.  The fit is an
+ * exponentially weighted least squares line t = mt + period
+ * (k - mk), updated with running means and covariances of
+ * the conversion number k and time t, so no sums grow with
+ * the run time.  Until DRIFT_WINDOW samples are in, every
+ * sample has the same weight.
+ *
+ * The times are when CR was seen, so the fitted timestamps
+ * lag the true ready times by the mean poll latency but no
+ * longer move with it.
+ */
+
+/* include headers */
+#include "NAU7802_drift.h"
+#include <string.h>
+#include <math.h>
+
+/*
+ * Initialize for conversions at rate, one of the
+ * CRS_ macros.  An invalid rate is taken as CRS_10.
+ */
+void
+NAU7802_driftInit(struct drift_est *dr, uint8_t rate){
+	memset(dr, 0, sizeof(*dr));
+	dr->nominal_ns = NAU7802_ratePeriod(rate);
+	if(dr->nominal_ns == 0)
+		dr->nominal_ns = NAU7802_ratePeriod(CRS_10);
+	dr->period_ns = dr->nominal_ns;
+}
+
+/*
+ * Add a conversion numbered conv, e.g. by
+ * NAU7802_seqUpdate, that was seen at t_ns.  Leave
+ * out samples flagged SAMPLE_DUP.
+ *
+ * Return the fitted time of the conversion.
+ */
+uint64_t
+NAU7802_driftUpdate(struct drift_est *dr, uint32_t conv, uint64_t t_ns){
+	double k, t, dk, dt, a, r, p;
+
+	if(dr->n == 0){
+		dr->conv0 = conv;
+		dr->t0_ns = t_ns;
+	}
+	k = (double)(uint32_t)(conv - dr->conv0);
+	t = (double)(int64_t)(t_ns - dr->t0_ns);
+	dr->n++;
+	a = dr->n < DRIFT_WINDOW ? 1.0 / dr->n : 1.0 / DRIFT_WINDOW;
+	if(dr->n > 2){
+		r = t - (dr->mt + dr->period_ns * (k - dr->mk));
+		dr->var_ns += a * (r * r - dr->var_ns);
+	}
+	dk = k - dr->mk;
+	dt = t - dr->mt;
+	dr->mk += a * dk;
+	dr->mt += a * dt;
+	dr->ckk = (1.0 - a) * (dr->ckk + a * dk * dk);
+	dr->ckt = (1.0 - a) * (dr->ckt + a * dk * dt);
+	if(dr->n >= 2 && dr->ckk > 0.0){
+		p = dr->ckt / dr->ckk;
+		if(fabs(p / dr->nominal_ns - 1.0) * 1e6 <= DRIFT_MAX_PPM)
+			dr->period_ns = p;
+		else
+			dr->rejected++;
+	}
+	return NAU7802_driftTime(dr, conv);
+}
+
+/*
+ * Get the fitted time of conversion conv, which
+ * may be ahead, e.g. to predict the next ready
+ * time.
+ *
+ * Return CLOCK_MONOTONIC time in ns or 0 before
+ * the first sample.
+ */
+uint64_t
+NAU7802_driftTime(const struct drift_est *dr, uint32_t conv){
+	double k;
+	if(dr->n == 0)
+		return 0;
+	k = (double)(int32_t)(conv - dr->conv0);
+	return dr->t0_ns + (int64_t)llround(dr->mt + dr->period_ns * (k - dr->mk));
+}
+
+/*
+ * Get the measured conversion rate.
+ *
+ * Return samples per second, the CRS rate
+ * until two samples are in.
+ */
+double
+NAU7802_driftRate(const struct drift_est *dr){
+	return 1e9 / dr->period_ns;
+}
+
+/*
+ * Get the error of the conversion rate against
+ * the CRS rate, positive when faster.
+ *
+ * Return error in parts per million.
+ */
+double
+NAU7802_driftPPM(const struct drift_est *dr){
+	return (dr->nominal_ns / dr->period_ns - 1.0) * 1e6;
+}
+
+/*
+ * Get the RMS difference of the times seen and
+ * the fit, the jitter the fitted times remove.
+ *
+ * Return jitter in ns.
+ */
+double
+NAU7802_driftJitter(const struct drift_est *dr){
+	return sqrt(dr->var_ns);
+}
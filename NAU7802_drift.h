@@ -0,0 +1,52 @@
+/*
+ * Header for conversion clock drift estimation.  The internal
+ * oscillator makes the real data rate differ from the CRS
+ * setting.  A line fitted to the times conversions were seen
+ * against their conversion numbers gives the real period and
+ * a timestamp for every conversion without the poll jitter.
+ */
+
+#ifndef NAU7802_DRIFT_H
+#define NAU7802_DRIFT_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define DRIFT_WINDOW 256	/* samples the fit remembers */
+#define DRIFT_MAX_PPM 100000.0	/* fits further from the CRS rate are ignored */
+
+struct drift_est{
+	double nominal_ns;	/* period from the CRS rate */
+	double period_ns;	/* fitted period */
+	uint32_t n;		/* samples fitted */
+	uint32_t conv0;		/* conversion number of first sample */
+	uint64_t t0_ns;		/* time of first sample */
+	double mk, mt;		/* weighted means of conversion and time */
+	double ckk, ckt;	/* weighted covariances */
+	double var_ns;		/* weighted mean square residual */
+	uint32_t rejected;	/* fits outside DRIFT_MAX_PPM */
+};
+
+void NAU7802_driftInit(struct drift_est *dr, uint8_t rate);
+
+uint64_t NAU7802_driftUpdate(struct drift_est *dr, uint32_t conv, uint64_t t_ns);
+
+uint64_t NAU7802_driftTime(const struct drift_est *dr, uint32_t conv);
+
+double NAU7802_driftRate(const struct drift_est *dr);
+
+double NAU7802_driftPPM(const struct drift_est *dr);
+
+double NAU7802_driftJitter(const struct drift_est *dr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
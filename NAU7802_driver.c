@@ -5,11 +5,19 @@
 
 /* include headers */
 #include "NAU7802.h"
+#include "NAU7802_event.h"
+#include "NAU7802_capture.h"
+#include "NAU7802_lut.h"
+#include "NAU7802_temp.h"
+#include "NAU7802_dual.h"
+#include "NAU7802_record.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
 
+#define TEST16_PATH_LEN 256
+
 void
 test0(int fd){
 	if(NAU7802_resetPowerDown(fd))
@@ -252,6 +260,396 @@ test9(int fd){
 	}
 }
 
+void
+print_event(const struct load_event *ev, void *arg){
+	printf("EVENT rule %i type %i : load %+10.4f delta %+10.4f\n",
+			ev->rule, ev->type, ev->load, ev->delta);
+}
+
+void
+test10(int fd){
+	int z;
+	float limit, step;
+	struct load_cal lc;
+	struct event_engine ee;
+	NAU7802_init_load_cal(&lc);
+	NAU7802_init_event_engine(&ee);
+	printf("\n...Test...10\n");
+	printf("Enter upper limit : ");
+	scanf("%f", &limit);
+	printf("Enter step size : ");
+	scanf("%f", &step);
+	NAU7802_addEventRule(&ee, EVENT_ABOVE, limit, limit * 0.05, 0,
+			print_event, NULL);
+	NAU7802_addEventRule(&ee, EVENT_STEP, step, step * 0.1, 200,
+			print_event, NULL);
+	NAU7802_setLoadCalGain(&lc, 0.25);
+	NAU7802_setShiftLoad(&lc, 0);
+	z = NAU7802_calibrate(fd, CALMOD_GCS);
+	printf("CAL_ERR : %i\n", z);
+	delay(1000);
+	NAU7802_getLinearLoad(fd, &lc);
+	delay(1000);
+	NAU7802_tareLoad(fd, &lc);
+	for(;;){
+		while(!NAU7802_CR(fd));
+		NAU7802_getEventLoad(fd, &lc, &ee);
+	}
+}
+
+void
+trigger_capture(const struct load_event *ev, void *arg){
+	if(NAU7802_triggerCapture(arg, 2000, 2000, "capture.txt") == 0)
+		printf("Capture triggered : load %+10.4f\n", ev->load);
+}
+
+void
+test11(int fd){
+	int z, adc;
+	float step;
+	struct load_cal lc;
+	struct event_engine ee;
+	struct capture_buf cb;
+	NAU7802_init_load_cal(&lc);
+	NAU7802_init_event_engine(&ee);
+	printf("\n...Test...11\n");
+	if(NAU7802_initCapture(&cb, 4096) == -1){
+		printf("Capture buffer failed\n");
+		return;
+	}
+	printf("Enter step size : ");
+	scanf("%f", &step);
+	NAU7802_addEventRule(&ee, EVENT_STEP, step, step * 0.1, 200,
+			trigger_capture, &cb);
+	NAU7802_setLoadCalGain(&lc, 0.25);
+	NAU7802_setShiftLoad(&lc, 0);
+	z = NAU7802_calibrate(fd, CALMOD_GCS);
+	printf("CAL_ERR : %i\n", z);
+	delay(1000);
+	NAU7802_getLinearLoad(fd, &lc);
+	delay(1000);
+	NAU7802_tareLoad(fd, &lc);
+	NAU7802_startCaptureWriter(&cb);
+	for(;;){
+		while(!NAU7802_CR(fd));
+		adc = NAU7802_readADC(fd);
+		NAU7802_pushCapture(&cb, adc, NAU7802_getTimestamp());
+		NAU7802_evalEvents(&ee, NAU7802_getLoadFromADC(&lc, adc),
+				NAU7802_getTimestamp());
+	}
+}
+
+
+#define TEST12_LEN 320
+
+void
+test12(int fd){
+	int32_t raw[TEST12_LEN];
+	uint64_t t_ns[TEST12_LEN], t0, t1, t2;
+	uint8_t status[TEST12_LEN];
+	double load[TEST12_LEN], sum;
+	struct sample_block blk = {raw, t_ns, status, TEST12_LEN};
+	struct load_cal lc;
+	int i, n, waiting, errs;
+	NAU7802_init_load_cal(&lc);
+	printf("\n...Test...12\n");
+	NAU7802_setLoadCalGain(&lc, 0.25);
+	NAU7802_setShiftLoad(&lc, 0);
+	NAU7802_setSampleRate(fd, CRS_320);
+	NAU7802_calibrate(fd, CALMOD_GCS);
+	delay(1000);
+	NAU7802_tareLoad(fd, &lc);
+	for(;;){
+		n = NAU7802_readSamples(fd, TEST12_LEN, &blk);
+		t0 = NAU7802_getTimestamp();
+		NAU7802_getLoadFromADCBlock(&lc, raw, load, n);
+		t1 = NAU7802_getTimestamp();
+		for(i=0; i<n; i++)
+			load[i] = NAU7802_getLoadFromADC(&lc, raw[i]);
+		t2 = NAU7802_getTimestamp();
+		sum = 0.0;
+		waiting = errs = 0;
+		for(i=0; i<n; i++){
+			sum += load[i];
+			waiting += (status[i] & SAMPLE_WAITING) != 0;
+			errs += (status[i] & SAMPLE_IO_ERR) != 0;
+		}
+		printf("%d samples in %.3f s : mean %10.4f  waiting %d  errors %d"
+				"  convert %.1f ns/sample block, %.1f per call\n",
+				n, (t_ns[n - 1] - t_ns[0]) / 1e9, sum / n, waiting, errs,
+				(double)(t1 - t0) / n, (double)(t2 - t1) / n);
+	}
+}
+
+void
+test13(int fd){
+	int32_t raw[TEST12_LEN];
+	uint64_t t_ns[TEST12_LEN];
+	uint8_t status[TEST12_LEN];
+	struct sample_block blk = {raw, t_ns, status, 64};
+	struct lut_cal lut;
+	int64_t sum;
+	float known;
+	int i, n, good, points;
+	NAU7802_lutInit(&lut);
+	printf("\n...Test...13\n");
+	NAU7802_calibrate(fd, CALMOD_GCS);
+	delay(1000);
+	if(NAU7802_lutRestore(&lut, "lut.cal") == 0)
+		printf("Calibration read from lut.cal\n");
+	else{
+		printf("Enter number of known loads : ");
+		scanf("%i", &points);
+		for(i=0; i<points; i++){
+			printf("Place load and enter its value : ");
+			scanf("%f", &known);
+			n = NAU7802_readSamples(fd, 64, &blk);
+			for(sum=0, good=0; n>0; n--)
+				if(!(status[n - 1] & (SAMPLE_IO_ERR | SAMPLE_TIMEOUT))){
+					sum += raw[n - 1];
+					good++;
+				}
+			if(good == 0){
+				printf("No samples read, point skipped\n");
+				continue;
+			}
+			NAU7802_lutAddPoint(&lut, (int32_t)(sum / good), known);
+		}
+		if(NAU7802_lutFit(&lut, LUT_POLY, points > 3 ? 3 : points - 1) == 0)
+			printf("Polynomial max error : %f\n", NAU7802_lutMaxError(&lut));
+		if(NAU7802_lutFit(&lut, LUT_PWL, 0) == -1){
+			printf("Calibration failed\n");
+			return;
+		}
+		printf("Piecewise max error : %f\n", NAU7802_lutMaxError(&lut));
+		if(NAU7802_lutSave(&lut, "lut.cal") == 0)
+			printf("Calibration saved to lut.cal\n");
+	}
+	for(;;){
+		while(!NAU7802_CR(fd));
+		printf("Load : %f\n", NAU7802_lutLoad(&lut, NAU7802_readADC(fd)));
+	}
+}
+
+void
+test14(int fd, int gain){
+	struct load_cal lc;
+	struct temp_comp tc;
+	double load, sum=0.0;
+	int64_t raw_sum=0;
+	int interval, learn, n=0;
+	uint32_t reads=0;
+	NAU7802_init_load_cal(&lc);
+	printf("\n...Test...14\n");
+	printf("Enter temperature interval ms : ");
+	scanf("%i", &interval);
+	printf("Learn offset drift with no load (1/0) : ");
+	scanf("%i", &learn);
+	NAU7802_setLoadCalGain(&lc, 0.25);
+	NAU7802_setShiftLoad(&lc, 0);
+	NAU7802_calibrate(fd, CALMOD_GCS);
+	delay(1000);
+	NAU7802_tareLoad(fd, &lc);
+	NAU7802_initTempComp(&tc, interval, gain);
+	for(;;){
+		while(!NAU7802_CR(fd));
+		if(NAU7802_getTempCompLoad(fd, &tc, &lc, &load)){
+			sum += load;
+			raw_sum += tc.raw;
+			n++;
+		}
+		if(tc.temp_reads == reads)
+			continue;
+		reads = tc.temp_reads;
+		if(learn && n > 0 && reads > 1)
+			NAU7802_tempAddZeroPoint(&tc, (int32_t)(raw_sum / n));
+		printf("Load %10.4f  temp %10.1f  offset slope %8.3f  "
+				"lost %u in %u reads, %.1f per read\n",
+				n ? sum / n : 0.0, tc.temp, tc.off_slope, tc.lost,
+				tc.temp_reads, NAU7802_tempLostPerRead(&tc));
+		sum = 0.0;
+		raw_sum = 0;
+		n = 0;
+	}
+}
+
+void
+test15(int fd){
+	struct dual_acq da;
+	struct dual_sample s;
+	double sum[2] = {0.0, 0.0};
+	int n[2] = {0, 0}, run, ch;
+	uint64_t next;
+	printf("\n...Test...15\n");
+	printf("Enter conversions per channel before switching : ");
+	scanf("%i", &run);
+	NAU7802_setSampleRate(fd, CRS_320);
+	NAU7802_dualInit(&da, fd, run);
+	printf("CAL_ERR : %i\n", NAU7802_dualCalibrate(&da));
+	for(ch=0; ch<2; ch++){
+		NAU7802_setLoadCalGain(&da.chan[ch].lc, 0.25);
+		NAU7802_setShiftLoad(&da.chan[ch].lc, 0);
+	}
+	next = NAU7802_getTimestamp() + 1000000000ULL;
+	for(;;){
+		while(!NAU7802_CR(fd));
+		if(NAU7802_dualRead(&da, &s)){
+			sum[s.ch - 1] += s.load;
+			n[s.ch - 1]++;
+		}
+		if(NAU7802_getTimestamp() < next)
+			continue;
+		next += 1000000000ULL;
+		printf("CH1 %10.4f %6.1f SPS  CH2 %10.4f %6.1f SPS  lost %u\n",
+				n[0] ? sum[0] / n[0] : 0.0, NAU7802_dualSPS(&da, 1),
+				n[1] ? sum[1] / n[1] : 0.0, NAU7802_dualSPS(&da, 2),
+				da.lost);
+		sum[0] = sum[1] = 0.0;
+		n[0] = n[1] = 0;
+	}
+}
+
+/*
+ * Tare lc with the mean load of the first second
+ * of a recording, as NAU7802_tareLoad does live.
+ */
+int
+replay_tare(const char *path, struct load_cal *lc){
+	struct rec_file rf;
+	struct rec_sample s;
+	double sum=0.0;
+	uint64_t end=0;
+	int n=0;
+	if(NAU7802_replayOpen(&rf, path) == -1)
+		return -1;
+	lc->offset = 0.0;
+	while(NAU7802_replayNext(&rf, &s, 0.0)){
+		if(n == 0)
+			end = s.t_ns + 1000000000ULL;
+		if(s.t_ns >= end)
+			break;
+		if(s.status & (SAMPLE_IO_ERR | SAMPLE_TIMEOUT))
+			continue;
+		sum += NAU7802_getLoadFromADC(lc, s.raw);
+		n++;
+	}
+	NAU7802_recClose(&rf);
+	lc->offset = n ? sum / n : 0.0;
+	return n;
+}
+
+void
+test16(int fd, int gain){
+	char path[TEST16_PATH_LEN];
+	struct rec_file rf;
+	struct rec_sample s;
+	struct load_cal lc;
+	double load, sum, sum2, min, max;
+	uint64_t t0, settle;
+	int mode, z, rate, shift, n, skip;
+	float cGain, lpf;
+	printf("\n...Test...16\n");
+	printf("Enter file : ");
+	scanf("%255s", path);
+	printf("Enter 0 to record, 1 to replay : ");
+	scanf("%i", &mode);
+	if(mode == 0){
+		printf("Enter rate bits : ");
+		scanf("%i", &rate);
+		NAU7802_setSampleRate(fd, rate);
+		z = NAU7802_calibrate(fd, CALMOD_GCS);
+		printf("CAL_ERR : %i\n", z);
+		delay(1000);
+		if(NAU7802_recOpen(&rf, path, rate, gain) == -1){
+			printf("Cannot create %s\n", path);
+			return;
+		}
+		n = NAU7802_recordADC(fd, &rf, (int)(pow(2, (double)rate) * 600));
+		if(NAU7802_recClose(&rf) == -1)
+			n = -1;
+		printf("Recorded %i samples to %s\n", n, path);
+		return;
+	}
+
+	/* the loop of test9 on the recording, in a fraction of the time */
+	NAU7802_init_load_cal(&lc);
+	for(;;){
+		printf("Enter Cal Gain : ");
+		if(scanf("%f", &cGain) != 1)
+			return;
+		printf("Enter shift bits : ");
+		scanf("%i", &shift);
+		printf("Enter LPF_Beta : ");
+		scanf("%f", &lpf);
+		NAU7802_setLoadCalGain(&lc, cGain);
+		NAU7802_setShiftLoad(&lc, shift);
+		lc.LPF_Beta = lpf;
+		lc.smoothLoad = 0.0;
+		t0 = NAU7802_getTimestamp();
+		if(replay_tare(path, &lc) == -1 || NAU7802_replayOpen(&rf, path) == -1){
+			printf("Cannot replay %s\n", path);
+			return;
+		}
+		n = skip = 0;
+		sum = sum2 = 0.0;
+		min = DBL_MAX;
+		max = -DBL_MAX;
+		settle = 0;
+		while(NAU7802_replayNext(&rf, &s, 0.0)){
+			if(s.status & (SAMPLE_IO_ERR | SAMPLE_TIMEOUT)){
+				skip++;
+				continue;
+			}
+			load = NAU7802_getSmoothLoadFromADC(&lc, s.raw);
+			/* let the filter settle for a second */
+			if(settle == 0)
+				settle = s.t_ns + 1000000000ULL;
+			if(s.t_ns < settle)
+				continue;
+			sum += load;
+			sum2 += load * load;
+			if(load < min)
+				min = load;
+			if(load > max)
+				max = load;
+			n++;
+		}
+		NAU7802_recClose(&rf);
+		if(n == 0){
+			printf("No samples after the first second\n");
+			continue;
+		}
+		sum /= n;
+		printf("Replayed %llu samples in %.1f ms, %i skipped\n",
+				(unsigned long long)rf.count,
+				(NAU7802_getTimestamp() - t0) / 1e6, skip);
+		printf("Load mean %+10.4f sd %10.4f p-p %10.4f\n", sum,
+				sqrt(fmax(sum2 / n - sum * sum, 0.0)), max - min);
+	}
+}
+
+/*
+ * Fill the event queue exactly before the first pop: a
+ * consumer EVENT_QUEUE_LEN behind must drain, not spin.
+ * Needs no load cell.
+ */
+void
+test17(int fd){
+	int i, n=0;
+	struct event_engine ee;
+	struct event_cursor ec;
+	struct load_event ev;
+	NAU7802_init_event_engine(&ee);
+	printf("\n...Test...17\n");
+	NAU7802_addEventRule(&ee, EVENT_ABOVE, 1.0, 0.5, 0, NULL, NULL);
+	NAU7802_initEventCursor(&ee, &ec);
+	for(i=0; i<2 * EVENT_QUEUE_LEN; i++)
+		NAU7802_evalEvents(&ee, i & 1 ? 0.0 : 2.0, NAU7802_getTimestamp());
+	while(NAU7802_popEvent(&ee, &ec, &ev))
+		n++;
+	printf("Fired %u : read %i : lost %u : %s\n", atomic_load(&ee.head),
+			n, ec.lost, n + ec.lost == EVENT_QUEUE_LEN ? "PASS" : "FAIL");
+}
 
 int
 main(int argc, char **argv){
@@ -317,6 +715,22 @@ main(int argc, char **argv){
 		test8(fd);
 	else if(z == 9)
 		test9(fd);
+	else if(z == 10)
+		test10(fd);
+	else if(z == 11)
+		test11(fd);
+	else if(z == 12)
+		test12(fd);
+	else if(z == 13)
+		test13(fd);
+	else if(z == 14)
+		test14(fd, gain);
+	else if(z == 15)
+		test15(fd);
+	else if(z == 16)
+		test16(fd, gain);
+	else if(z == 17)
+		test17(fd);
 	else
 		printf("+++++ Test not found +++++\n");
 
@@ -0,0 +1,137 @@
+/*
+ * Dual channel acquisition.  The chip keeps separate offset
+ * and gain calibration registers for each channel and applies
+ * the ones of the selected channel, so a switch only writes
+ * CHS and discards the unsettled conversions.  The registers
+ * are cached after calibrating so NAU7802_dualRestoreCal can
+ * put them back after a reset without calibrating again.
+ *
+ * With run conversions per channel before each switch, every
+ * channel gets run / (run + discard) of half the CRS rate.
+ */
+
+/* include headers */
+#include "NAU7802_dual.h"
+#include <string.h>
+
+/*
+ * Select ch and start discarding.
+ */
+static void
+dual_switch(struct dual_acq *da, int ch){
+	NAU7802_selectChannel(da->fd, ch);
+	da->ch = ch;
+	da->taken = 0;
+	da->skip = da->discard;
+}
+
+/*
+ * Initialize for a configured chip on fd, taking run
+ * conversions of a channel before switching.  CH1 is
+ * selected.  Both channels get a default load_cal.
+ *
+ * Return CHS bit or -1 on failure.
+ */
+int
+NAU7802_dualInit(struct dual_acq *da, int fd, int run){
+	memset(da, 0, sizeof(*da));
+	da->fd = fd;
+	da->run = run > 0 ? run : 1;
+	da->discard = DUAL_DISCARD;
+	NAU7802_init_load_cal(&da->chan[0].lc);
+	NAU7802_init_load_cal(&da->chan[1].lc);
+	da->ch = 1;
+	da->skip = da->discard;
+	return NAU7802_selectChannel(fd, 1);
+}
+
+/*
+ * Calibrate both channels and cache their calibration
+ * registers.  Blocks for a few seconds.  CH1 is
+ * selected afterwards.
+ *
+ * Return CAL_ERR bit of either channel. 1=ERROR, 0=NO ERROR.
+ */
+int
+NAU7802_dualCalibrate(struct dual_acq *da){
+	struct dual_chan *c;
+	int ch, z=0;
+	for(ch=1; ch<=2; ch++){
+		c = &da->chan[ch - 1];
+		NAU7802_selectChannel(da->fd, ch);
+		z |= NAU7802_calibrate(da->fd, CALMOD_GCS);
+		delay(1000);
+		c->cal_valid = NAU7802_readCal(da->fd, ch, &c->ocal, &c->gcal) == 0;
+	}
+	dual_switch(da, 1);
+	return z;
+}
+
+/*
+ * Write the cached calibration registers of both
+ * channels back to the chip.
+ *
+ * Return 0 or -1 if a channel has none cached or
+ * a write failed.
+ */
+int
+NAU7802_dualRestoreCal(struct dual_acq *da){
+	struct dual_chan *c;
+	int ch;
+	for(ch=1; ch<=2; ch++){
+		c = &da->chan[ch - 1];
+		if(!c->cal_valid ||
+			NAU7802_writeCal(da->fd, ch, c->ocal, c->gcal) == -1)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Read the conversion that is ready, call after
+ * NAU7802_CR returns 1.  Unsettled conversions after
+ * a switch are discarded and counted in lost.
+ *
+ * Return 1 if s was filled or 0 if the conversion
+ * was discarded.
+ */
+int
+NAU7802_dualRead(struct dual_acq *da, struct dual_sample *s){
+	struct dual_chan *c = &da->chan[da->ch - 1];
+	int32_t raw;
+
+	raw = NAU7802_readADC(da->fd);
+	if(da->skip > 0){
+		da->skip--;
+		da->lost++;
+		return 0;
+	}
+	s->ch = da->ch;
+	s->raw = raw;
+	s->t_ns = NAU7802_getTimestamp();
+	s->load = NAU7802_getLoadFromADC(&c->lc, raw);
+	s->seq = c->samples++;
+	if(s->seq == 0)
+		c->first_ns = s->t_ns;
+	c->last_ns = s->t_ns;
+	if(++da->taken >= da->run)
+		dual_switch(da, da->ch == 1 ? 2 : 1);
+	return 1;
+}
+
+/*
+ * Get the samples per second a channel got
+ * since its first sample.
+ *
+ * Return SPS or 0 if not known yet.
+ */
+double
+NAU7802_dualSPS(struct dual_acq *da, int ch){
+	struct dual_chan *c;
+	if(ch != 1 && ch != 2)
+		return 0.0;
+	c = &da->chan[ch - 1];
+	if(c->samples < 2 || c->last_ns <= c->first_ns)
+		return 0.0;
+	return (c->samples - 1) / ((c->last_ns - c->first_ns) / 1e9);
+}
@@ -0,0 +1,65 @@
+/*
+ * Header for dual channel acquisition.  Conversions alternate
+ * between CH1 and CH2 with the CHS bit so one chip can read a
+ * second cell or a reference bridge.  Each channel has its own
+ * load calibration, chip calibration and sample count.
+ */
+
+#ifndef NAU7802_DUAL_H
+#define NAU7802_DUAL_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define DUAL_DISCARD 2		/* conversions discarded after each switch */
+
+struct dual_sample{
+	int ch;			/* channel 1 or 2 */
+	uint32_t seq;		/* sample number of the channel */
+	int32_t raw;		/* raw ADC value */
+	double load;		/* load with the channel calibration */
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of read */
+};
+
+struct dual_chan{
+	struct load_cal lc;	/* load calibration of the channel */
+	int32_t ocal;		/* cached offset calibration register */
+	uint32_t gcal;		/* cached gain calibration register */
+	int cal_valid;		/* 1 when ocal and gcal are cached */
+	uint32_t samples;	/* samples delivered */
+	uint64_t first_ns;	/* time of first sample */
+	uint64_t last_ns;	/* time of last sample */
+};
+
+struct dual_acq{
+	int fd;
+	int ch;			/* channel selected, 1 or 2 */
+	int run;		/* conversions to take before switching */
+	int taken;		/* conversions taken since the switch */
+	int discard;		/* conversions discarded after a switch */
+	int skip;		/* conversions left to discard */
+	uint32_t lost;		/* conversions discarded */
+	struct dual_chan chan[2];
+};
+
+int NAU7802_dualInit(struct dual_acq *da, int fd, int run);
+
+int NAU7802_dualCalibrate(struct dual_acq *da);
+
+int NAU7802_dualRestoreCal(struct dual_acq *da);
+
+int NAU7802_dualRead(struct dual_acq *da, struct dual_sample *s);
+
+double NAU7802_dualSPS(struct dual_acq *da, int ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Load event engine.  Evaluates registered rules once per
+ * sample and publishes fired rules to callbacks and to a
+ * queue that any number of consumers can read with their
+ * own cursor.  The cost per sample depends only on the
+ * number of rules, never on the number of consumers.
+ */
+
+/* include headers */
+#include "NAU7802_event.h"
+#include <string.h>
+
+#define HIST_MASK (EVENT_HIST_LEN - 1)
+#define QUEUE_MASK (EVENT_QUEUE_LEN - 1)
+
+/*
+ * Publish a fired rule to the queue and call the
+ * rule callback if one was registered.
+ */
+static void
+fire_event(struct event_engine *ee, int r, double load,
+		double delta, uint64_t t_ns){
+	struct load_event *ev;
+	unsigned int h;
+	h = atomic_load_explicit(&ee->head, memory_order_relaxed);
+	ev = &ee->queue[h & QUEUE_MASK];
+	ev->rule = r;
+	ev->type = ee->rule[r].type;
+	ev->load = load;
+	ev->delta = delta;
+	ev->t_ns = t_ns;
+	atomic_store_explicit(&ee->head, h + 1, memory_order_release);
+	if(ee->rule[r].cb)
+		ee->rule[r].cb(ev, ee->rule[r].arg);
+}
+
+/*
+ * Check if history sample idx is outside the rule window
+ * of the newest sample i taken at t_ns.
+ */
+static int
+expired(struct event_engine *ee, struct event_rule *er, uint32_t idx,
+		uint32_t i, uint64_t t_ns){
+	if(i - idx >= EVENT_HIST_LEN)
+		return 1;
+	return ee->hist_t[idx & HIST_MASK] + er->window_ns < t_ns;
+}
+
+/*
+ * Update the min and max wedges of a STEP rule with
+ * sample i.  Samples outside the window are dropped
+ * first so a wedge never holds more than EVENT_HIST_LEN
+ * entries.  Both wedges are amortized O(1) per sample.
+ */
+static void
+step_update(struct event_engine *ee, struct event_rule *er, uint32_t i,
+		double load, uint64_t t_ns){
+	while(er->min_head != er->min_tail &&
+		expired(ee, er, er->min_q[er->min_head & HIST_MASK], i, t_ns))
+		er->min_head++;
+	while(er->max_head != er->max_tail &&
+		expired(ee, er, er->max_q[er->max_head & HIST_MASK], i, t_ns))
+		er->max_head++;
+
+	while(er->min_tail != er->min_head &&
+		ee->hist_load[er->min_q[(er->min_tail - 1) & HIST_MASK] & HIST_MASK] >= load)
+		er->min_tail--;
+	er->min_q[er->min_tail++ & HIST_MASK] = i;
+	while(er->max_tail != er->max_head &&
+		ee->hist_load[er->max_q[(er->max_tail - 1) & HIST_MASK] & HIST_MASK] <= load)
+		er->max_tail--;
+	er->max_q[er->max_tail++ & HIST_MASK] = i;
+}
+
+/*
+ * Set an event engine to no rules and an
+ * empty queue.
+ */
+void
+NAU7802_init_event_engine(struct event_engine *ee){
+	memset(ee, 0, sizeof(*ee));
+	atomic_init(&ee->head, 0);
+}
+
+/*
+ * Register a rule.  limit is the threshold for ABOVE and
+ * BELOW, the load change for STEP and the load change per
+ * second for RATE.  A rule fires once and rearms after the
+ * value has moved back by hyst.  window_ms is the time span
+ * used by STEP and RATE and is ignored for thresholds.  RATE
+ * is not evaluated until a sample window_ms old exists, or
+ * the history is full, so start-up spikes over a shorter
+ * span do not fire it.
+ * cb may be NULL when events are only read from the queue.
+ *
+ * Return the rule index or -1 on invalid arguments or
+ * when the engine is full.
+ */
+int
+NAU7802_addEventRule(struct event_engine *ee, int type, double limit,
+		double hyst, int window_ms, event_cb cb, void *arg){
+	struct event_rule *er;
+	if(ee->nrules >= EVENT_MAX_RULES)
+		return -1;
+	if(!(	type == EVENT_ABOVE ||
+		type == EVENT_BELOW ||
+		type == EVENT_STEP ||
+		type == EVENT_RATE))
+		return -1;
+	if((type == EVENT_STEP || type == EVENT_RATE) && window_ms <= 0)
+		return -1;
+	if(hyst < 0.0)
+		return -1;
+
+	er = &ee->rule[ee->nrules];
+	memset(er, 0, sizeof(*er));
+	er->type = type;
+	er->limit = limit;
+	er->hyst = hyst;
+	er->window_ns = (uint64_t)window_ms * 1000000ULL;
+	er->cb = cb;
+	er->arg = arg;
+	er->armed = 1;
+	er->tail = ee->count;
+	return ee->nrules++;
+}
+
+/*
+ * Evaluate all rules against one load sample.  Call this
+ * from the acquisition loop only; consumers use
+ * NAU7802_popEvent.
+ *
+ * Return the number of rules that fired.
+ */
+int
+NAU7802_evalEvents(struct event_engine *ee, double load, uint64_t t_ns){
+	struct event_rule *er;
+	uint32_t i, idx;
+	double up, down, rate, dt;
+	int r, fired=0;
+
+	i = ee->count++;
+	ee->hist_load[i & HIST_MASK] = load;
+	ee->hist_t[i & HIST_MASK] = t_ns;
+
+	for(r=0; r<ee->nrules; r++){
+		er = &ee->rule[r];
+		if(er->type == EVENT_ABOVE){
+			if(er->armed && load > er->limit){
+				er->armed = 0;
+				fire_event(ee, r, load, 0.0, t_ns);
+				fired++;
+			}
+			else if(!er->armed && load < er->limit - er->hyst)
+				er->armed = 1;
+		}
+		else if(er->type == EVENT_BELOW){
+			if(er->armed && load < er->limit){
+				er->armed = 0;
+				fire_event(ee, r, load, 0.0, t_ns);
+				fired++;
+			}
+			else if(!er->armed && load > er->limit + er->hyst)
+				er->armed = 1;
+		}
+		else if(er->type == EVENT_STEP){
+			step_update(ee, er, i, load, t_ns);
+			up = load - ee->hist_load[er->min_q[er->min_head & HIST_MASK] & HIST_MASK];
+			down = ee->hist_load[er->max_q[er->max_head & HIST_MASK] & HIST_MASK] - load;
+			if(er->armed && (up >= er->limit || down >= er->limit)){
+				er->armed = 0;
+				fire_event(ee, r, load, up >= er->limit ? up : -down, t_ns);
+				fired++;
+			}
+			else if(!er->armed &&
+				up < er->limit - er->hyst &&
+				down < er->limit - er->hyst)
+				er->armed = 1;
+		}
+		else{
+			/* newest sample at least window_ns old */
+			while(er->tail != i &&
+				(i - er->tail >= EVENT_HIST_LEN ||
+				ee->hist_t[(er->tail + 1) & HIST_MASK] + er->window_ns <= t_ns))
+				er->tail++;
+			if(er->tail == i)
+				continue;
+			idx = er->tail & HIST_MASK;
+			/* a shorter span before a full window has been seen */
+			if(ee->hist_t[idx] + er->window_ns > t_ns &&
+				i - er->tail < EVENT_HIST_LEN - 1)
+				continue;
+			dt = (double)(t_ns - ee->hist_t[idx]) / 1e9;
+			if(dt <= 0.0)
+				continue;
+			rate = (load - ee->hist_load[idx]) / dt;
+			if(er->armed && (rate >= er->limit || -rate >= er->limit)){
+				er->armed = 0;
+				fire_event(ee, r, load, rate, t_ns);
+				fired++;
+			}
+			else if(!er->armed &&
+				rate < er->limit - er->hyst &&
+				-rate < er->limit - er->hyst)
+				er->armed = 1;
+		}
+	}
+	return fired;
+}
+
+/*
+ * Read the linear load like NAU7802_getLinearLoad and
+ * evaluate it against the engine rules.  The sample is
+ * timestamped with CLOCK_MONOTONIC.
+ *
+ * Returns load value.
+ */
+double
+NAU7802_getEventLoad(int fd, struct load_cal *lc, struct event_engine *ee){
+	double load;
+	load = NAU7802_getLinearLoad(fd, lc);
+	NAU7802_evalEvents(ee, load, NAU7802_getTimestamp());
+	return load;
+}
+
+/*
+ * Start a consumer at the current end of the
+ * queue so only new events are returned.
+ */
+void
+NAU7802_initEventCursor(struct event_engine *ee, struct event_cursor *ec){
+	ec->next = atomic_load_explicit(&ee->head, memory_order_acquire);
+	ec->lost = 0;
+}
+
+/*
+ * Read the next event for a consumer.  Never blocks and
+ * never slows down the acquisition loop.  Events a slow
+ * consumer did not read in time are counted in ec->lost.
+ *
+ * Return 1 if an event was copied to ev, 0 if there
+ * are no new events.
+ */
+int
+NAU7802_popEvent(struct event_engine *ee, struct event_cursor *ec,
+		struct load_event *ev){
+	unsigned int h;
+	for(;;){
+		h = atomic_load_explicit(&ee->head, memory_order_acquire);
+		if(ec->next == h)
+			return 0;
+		if(h - ec->next > EVENT_QUEUE_LEN){
+			ec->lost += h - ec->next - EVENT_QUEUE_LEN;
+			ec->next = h - EVENT_QUEUE_LEN;
+		}
+		*ev = ee->queue[ec->next & QUEUE_MASK];
+		atomic_thread_fence(memory_order_acquire);
+		h = atomic_load_explicit(&ee->head, memory_order_relaxed);
+		/* the producer may have reused the slot while copying */
+		if(h - ec->next >= EVENT_QUEUE_LEN){
+			ec->lost++;
+			ec->next++;
+			continue;
+		}
+		ec->next++;
+		return 1;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ * Header for the load event engine.  Rules are registered
+ * once and evaluated on every load sample so that consumers
+ * only wake up when a threshold, step or rate rule fires.
+ */
+
+#ifndef NAU7802_EVENT_H
+#define NAU7802_EVENT_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* define macros */
+#define EVENT_MAX_RULES 8	/* rules per engine */
+#define EVENT_HIST_LEN 1024	/* samples of history for STEP and RATE, power of 2 */
+#define EVENT_QUEUE_LEN 64	/* events kept for consumers, power of 2 */
+
+/* rule types */
+#define EVENT_ABOVE 0		/* load rises above limit */
+#define EVENT_BELOW 1		/* load falls below limit */
+#define EVENT_STEP 2		/* load changes more than limit within window */
+#define EVENT_RATE 3		/* load changes faster than limit per second */
+
+/* a fired rule */
+struct load_event{
+	int rule;		/* rule index returned by NAU7802_addEventRule */
+	int type;		/* EVENT_ABOVE, EVENT_BELOW, EVENT_STEP or EVENT_RATE */
+	double load;		/* load of the sample that fired the rule */
+	double delta;		/* step size or rate for STEP and RATE, else 0 */
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of the sample */
+};
+
+typedef void (*event_cb)(const struct load_event *ev, void *arg);
+
+struct event_rule{
+	int type;		/* rule type */
+	double limit;		/* threshold, step size or rate per second */
+	double hyst;		/* hysteresis before the rule rearms */
+	uint64_t window_ns;	/* time window for STEP and RATE */
+	event_cb cb;		/* callback or NULL to only queue */
+	void *arg;		/* passed to cb */
+	int armed;		/* 1 when the rule may fire */
+	uint32_t tail;		/* oldest history sample in window */
+	uint32_t min_head, min_tail;	/* wedge of increasing loads */
+	uint32_t max_head, max_tail;	/* wedge of decreasing loads */
+	uint32_t min_q[EVENT_HIST_LEN];	/* history indexes */
+	uint32_t max_q[EVENT_HIST_LEN];	/* history indexes */
+};
+
+/* consumer read position in the event queue */
+struct event_cursor{
+	uint32_t next;		/* next event to read */
+	uint32_t lost;		/* events overwritten before being read */
+};
+
+struct event_engine{
+	int nrules;
+	struct event_rule rule[EVENT_MAX_RULES];
+	uint32_t count;		/* samples evaluated */
+	double hist_load[EVENT_HIST_LEN];
+	uint64_t hist_t[EVENT_HIST_LEN];
+	atomic_uint head;	/* events written */
+	struct load_event queue[EVENT_QUEUE_LEN];
+};
+
+void NAU7802_init_event_engine(struct event_engine *ee);
+
+int NAU7802_addEventRule(struct event_engine *ee, int type, double limit,
+		double hyst, int window_ms, event_cb cb, void *arg);
+
+int NAU7802_evalEvents(struct event_engine *ee, double load, uint64_t t_ns);
+
+double NAU7802_getEventLoad(int fd, struct load_cal *lc, struct event_engine *ee);
+
+void NAU7802_initEventCursor(struct event_engine *ee, struct event_cursor *ec);
+
+int NAU7802_popEvent(struct event_engine *ee, struct event_cursor *ec,
+		struct load_event *ev);
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Latency histograms.  A value below HIST_SUB has its own
+ * bucket; above, the bucket is the position of the top bit
+ * and the next HIST_SUB_BITS bits.  Values of 2^HIST_OCTAVES
+ * ns or more go in the last bucket.
+ */
+
+/* include headers */
+#include "NAU7802_hist.h"
+#include <string.h>
+
+static unsigned int
+hist_index(uint64_t v){
+	unsigned int e;
+	if(v < HIST_SUB)
+		return (unsigned int)v;
+	if(v >> HIST_OCTAVES)
+		return HIST_BUCKETS - 1;
+	e = 63 - __builtin_clzll(v);
+	return (e - HIST_SUB_BITS + 1) * HIST_SUB +
+		(unsigned int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/*
+ * Get the middle of a bucket.
+ */
+static uint64_t
+hist_value(unsigned int i){
+	unsigned int o;
+	if(i < HIST_SUB)
+		return i;
+	o = i / HIST_SUB - 1;
+	return ((uint64_t)(HIST_SUB + i % HIST_SUB) << o) + ((1ULL << o) >> 1);
+}
+
+/*
+ * Clear all counts.
+ */
+void
+NAU7802_histInit(struct lat_hist *h){
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+/*
+ * Record a latency in ns.
+ */
+void
+NAU7802_histRecord(struct lat_hist *h, uint64_t ns){
+	h->bucket[hist_index(ns)]++;
+	h->count++;
+	h->sum += ns;
+	if(ns < h->min)
+		h->min = ns;
+	if(ns > h->max)
+		h->max = ns;
+}
+
+/*
+ * Add the counts of src to dst, e.g. to combine
+ * the histograms of several threads.
+ */
+void
+NAU7802_histMerge(struct lat_hist *dst, const struct lat_hist *src){
+	int i;
+	for(i=0; i<HIST_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if(src->min < dst->min)
+		dst->min = src->min;
+	if(src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*
+ * Get the latency below which p percent of the
+ * values fall, e.g. p=99.9 for p999.
+ *
+ * Return the latency in ns or 0 if empty.
+ */
+uint64_t
+NAU7802_histPercentile(const struct lat_hist *h, double p){
+	uint64_t want, seen=0, v;
+	int i;
+	if(h->count == 0)
+		return 0;
+	want = (uint64_t)(p / 100.0 * h->count + 0.5);
+	if(want < 1)
+		want = 1;
+	if(want > h->count)
+		want = h->count;
+	for(i=0; i<HIST_BUCKETS; i++){
+		seen += h->bucket[i];
+		if(seen >= want)
+			break;
+	}
+	v = hist_value(i);
+	if(v < h->min)
+		v = h->min;
+	if(v > h->max)
+		v = h->max;
+	return v;
+}
+
+/*
+ * Get the mean latency.
+ *
+ * Return the mean in ns or 0 if empty.
+ */
+uint64_t
+NAU7802_histMean(const struct lat_hist *h){
+	if(h->count == 0)
+		return 0;
+	return h->sum / h->count;
+}
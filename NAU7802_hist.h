@@ -0,0 +1,47 @@
+/*
+ * Header for latency histograms.  Buckets are logarithmic
+ * with HIST_SUB linear steps per power of two, as in HDR
+ * histograms, so recording is a few instructions and any
+ * percentile is known to within 1 / (2 * HIST_SUB) of its
+ * value from 1 ns up to 2^HIST_OCTAVES ns.
+ */
+
+#ifndef NAU7802_HIST_H
+#define NAU7802_HIST_H
+
+/* include headers */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define HIST_SUB_BITS 5		/* 32 buckets per power of two */
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_OCTAVES 40		/* largest value 2^40 ns, about 18 minutes */
+#define HIST_BUCKETS ((HIST_OCTAVES - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct lat_hist{
+	uint64_t count;		/* values recorded */
+	uint64_t sum;		/* sum of values */
+	uint64_t min;		/* smallest value */
+	uint64_t max;		/* largest value */
+	uint32_t bucket[HIST_BUCKETS];
+};
+
+void NAU7802_histInit(struct lat_hist *h);
+
+void NAU7802_histRecord(struct lat_hist *h, uint64_t ns);
+
+void NAU7802_histMerge(struct lat_hist *dst, const struct lat_hist *src);
+
+uint64_t NAU7802_histPercentile(const struct lat_hist *h, double p);
+
+uint64_t NAU7802_histMean(const struct lat_hist *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
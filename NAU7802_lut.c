@@ -0,0 +1,297 @@
+/*
+ * Multi-point calibration.  Only the points, the model and
+ * the tare are saved; the table is rebuilt from them by
+ * NAU7802_lutFit, which evaluates the model at the ends of
+ * every segment.  Within a segment the table interpolates
+ * linearly, which is exact for straight lines and within
+ * NAU7802_lutMaxError of the points otherwise.
+ */
+
+/* include headers */
+#include "NAU7802_lut.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#define LUT_MAGIC "NAU7802_LUT"
+#define LUT_VERSION 1
+#define LUT_SEG_MASK ((1u << LUT_SEG_SHIFT) - 1)
+#define LUT_RAW_BIAS 0x800000u	/* makes a 24 bit raw value unsigned */
+
+/*
+ * Evaluate the fitted model without the table.
+ */
+static double
+lut_model(int model, int order, const double *coef, const struct lut_point *p,
+		int n, double raw){
+	double x, y=0.0;
+	int i;
+	if(model == LUT_POLY){
+		x = raw / (double)LUT_RAW_BIAS;
+		for(i=order; i>=0; i--)
+			y = y * x + coef[i];
+		return y;
+	}
+	/* first or last line beyond the points */
+	for(i=1; i<n-1; i++)
+		if(raw < p[i].raw)
+			break;
+	return p[i-1].load + (raw - p[i-1].raw) *
+		(p[i].load - p[i-1].load) / (p[i].raw - p[i-1].raw);
+}
+
+/*
+ * Least squares polynomial of order of the points
+ * with gaussian elimination on the normal equations.
+ * coef is only written on success.
+ *
+ * Return 0 or -1 if singular.
+ */
+static int
+lut_fit_poly(const struct lut_cal *lut, int order, double *coef){
+	double a[LUT_MAX_ORDER + 1][LUT_MAX_ORDER + 2], xp[2 * LUT_MAX_ORDER + 1];
+	double c[LUT_MAX_ORDER + 1], x, f, t;
+	int n = order + 1, i, j, k, p;
+
+	memset(a, 0, sizeof(a));
+	for(k=0; k<lut->npoints; k++){
+		x = lut->point[k].raw / (double)LUT_RAW_BIAS;
+		xp[0] = 1.0;
+		for(i=1; i<2*n-1; i++)
+			xp[i] = xp[i-1] * x;
+		for(i=0; i<n; i++){
+			for(j=0; j<n; j++)
+				a[i][j] += xp[i + j];
+			a[i][n] += xp[i] * lut->point[k].load;
+		}
+	}
+	/* gaussian elimination with partial pivoting */
+	for(k=0; k<n; k++){
+		p = k;
+		for(i=k+1; i<n; i++)
+			if(fabs(a[i][k]) > fabs(a[p][k]))
+				p = i;
+		if(fabs(a[p][k]) < 1e-12)
+			return -1;
+		for(j=k; j<=n; j++){
+			t = a[k][j];
+			a[k][j] = a[p][j];
+			a[p][j] = t;
+		}
+		for(i=k+1; i<n; i++){
+			f = a[i][k] / a[k][k];
+			for(j=k; j<=n; j++)
+				a[i][j] -= f * a[k][j];
+		}
+	}
+	for(i=n-1; i>=0; i--){
+		t = a[i][n];
+		for(j=i+1; j<n; j++)
+			t -= a[i][j] * c[j];
+		c[i] = t / a[i][i];
+	}
+	memcpy(coef, c, n * sizeof(c[0]));
+	return 0;
+}
+
+/*
+ * Clear points, tare and table.
+ */
+void
+NAU7802_lutInit(struct lut_cal *lut){
+	memset(lut, 0, sizeof(*lut));
+	lut->order = 1;
+}
+
+/*
+ * Add a known load measured at a raw value read
+ * with shift 0, e.g. an average of NAU7802_readADC.
+ *
+ * Return the number of points or -1 if full.
+ */
+int
+NAU7802_lutAddPoint(struct lut_cal *lut, int32_t raw, double load){
+	if(lut->npoints >= LUT_MAX_POINTS)
+		return -1;
+	lut->point[lut->npoints].raw = raw;
+	lut->point[lut->npoints].load = load;
+	return ++lut->npoints;
+}
+
+/*
+ * Fit the points with model LUT_PWL, or LUT_POLY of
+ * order 1-LUT_MAX_ORDER, and build the table.  PWL
+ * needs 2 points with different raw values, POLY
+ * order + 1.  The tare is kept.  On failure the
+ * model and table are left as they were.
+ *
+ * Return 0 or -1 on too few points, a bad model
+ * or a singular fit.
+ */
+int
+NAU7802_lutFit(struct lut_cal *lut, int model, int order){
+	struct lut_point p[LUT_MAX_POINTS], t;
+	double coef[LUT_MAX_ORDER + 1] = {0.0}, r0, y0, y1;
+	int n = lut->npoints, i, j;
+
+	if(model == LUT_POLY){
+		if(order < 1 || order > LUT_MAX_ORDER || n < order + 1 ||
+			lut_fit_poly(lut, order, coef) == -1)
+			return -1;
+	}
+	else if(model == LUT_PWL){
+		if(n < 2)
+			return -1;
+		order = lut->order;
+	}
+	else
+		return -1;
+
+	/* sorted copy of the points for PWL */
+	memcpy(p, lut->point, n * sizeof(p[0]));
+	for(i=1; i<n; i++)
+		for(j=i; j>0 && p[j].raw < p[j-1].raw; j--){
+			t = p[j];
+			p[j] = p[j-1];
+			p[j-1] = t;
+		}
+	for(i=1; i<n && model == LUT_PWL; i++)
+		if(p[i].raw == p[i-1].raw)
+			return -1;
+
+	/* the fit is good, commit it */
+	lut->model = model;
+	lut->order = order;
+	if(model == LUT_POLY)
+		memcpy(lut->coef, coef, sizeof(coef));
+	for(i=0; i<LUT_SEGMENTS; i++){
+		r0 = (double)((int64_t)i << LUT_SEG_SHIFT) - LUT_RAW_BIAS;
+		y0 = lut_model(model, order, coef, p, n, r0);
+		y1 = lut_model(model, order, coef, p, n, r0 + (1 << LUT_SEG_SHIFT));
+		lut->base[i] = y0;
+		lut->slope[i] = (y1 - y0) / (1 << LUT_SEG_SHIFT);
+	}
+	return 0;
+}
+
+/*
+ * Convert a raw value with shift 0 to load
+ * with the table.
+ *
+ * Return load value.
+ */
+double
+NAU7802_lutLoad(const struct lut_cal *lut, int32_t raw){
+	uint32_t u = ((uint32_t)raw + LUT_RAW_BIAS) & 0xFFFFFF;
+	uint32_t i = u >> LUT_SEG_SHIFT;
+	return lut->base[i] + lut->slope[i] * (double)(u & LUT_SEG_MASK) - lut->offset;
+}
+
+/*
+ * Convert n raw values with the table.
+ */
+void
+NAU7802_lutLoadBlock(const struct lut_cal *lut, const int32_t *raw,
+		double *load, int n){
+	int i;
+	for(i=0; i<n; i++)
+		load[i] = NAU7802_lutLoad(lut, raw[i]);
+}
+
+/*
+ * Tare so that raw reads as 0.
+ *
+ * Returns the difference of the old offset and
+ * new offset.
+ */
+double
+NAU7802_lutTare(struct lut_cal *lut, int32_t raw){
+	double old = lut->offset;
+	lut->offset = 0.0;
+	lut->offset = NAU7802_lutLoad(lut, raw);
+	return old - lut->offset;
+}
+
+/*
+ * Get the largest difference between the known
+ * loads and the table at the calibration points,
+ * ignoring the tare.
+ *
+ * Return the error in load units.
+ */
+double
+NAU7802_lutMaxError(const struct lut_cal *lut){
+	double e, max=0.0;
+	int i;
+	for(i=0; i<lut->npoints; i++){
+		e = fabs(NAU7802_lutLoad(lut, lut->point[i].raw) + lut->offset -
+				lut->point[i].load);
+		if(e > max)
+			max = e;
+	}
+	return max;
+}
+
+/*
+ * Save the points, model and tare as text.
+ *
+ * Return 0 or -1 on failure.
+ */
+int
+NAU7802_lutSave(const struct lut_cal *lut, const char *path){
+	FILE *fp;
+	int i, z;
+	fp = fopen(path, "w");
+	if(fp == NULL)
+		return -1;
+	fprintf(fp, "%s %d\n", LUT_MAGIC, LUT_VERSION);
+	fprintf(fp, "%d %d %d %.17g\n", lut->model, lut->order, lut->npoints,
+			lut->offset);
+	for(i=0; i<lut->npoints; i++)
+		fprintf(fp, "%" PRId32 " %.17g\n", lut->point[i].raw, lut->point[i].load);
+	z = ferror(fp) ? -1 : 0;
+	if(fclose(fp) != 0)
+		z = -1;
+	return z;
+}
+
+/*
+ * Read a file from NAU7802_lutSave and rebuild
+ * the table.  lut is unchanged on failure.
+ *
+ * Return 0 or -1 on failure.
+ */
+int
+NAU7802_lutRestore(struct lut_cal *lut, const char *path){
+	struct lut_cal tmp;
+	char magic[16];
+	int version, model, order, n, i;
+	double offset;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if(fp == NULL)
+		return -1;
+	NAU7802_lutInit(&tmp);
+	if(fscanf(fp, "%15s %d", magic, &version) != 2 ||
+		strcmp(magic, LUT_MAGIC) != 0 || version != LUT_VERSION ||
+		fscanf(fp, "%d %d %d %lf", &model, &order, &n, &offset) != 4 ||
+		n < 0 || n > LUT_MAX_POINTS){
+		fclose(fp);
+		return -1;
+	}
+	for(i=0; i<n; i++)
+		if(fscanf(fp, "%" SCNd32 " %lf", &tmp.point[i].raw,
+				&tmp.point[i].load) != 2){
+			fclose(fp);
+			return -1;
+		}
+	fclose(fp);
+	tmp.npoints = n;
+	tmp.offset = offset;
+	if(NAU7802_lutFit(&tmp, model, order) == -1)
+		return -1;
+	*lut = tmp;
+	return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Header for multi-point calibration.  Known loads measured
+ * at several raw values are fitted with straight lines between
+ * the points or with a polynomial, and the fit is compiled
+ * into a table of LUT_SEGMENTS line segments indexed by the
+ * top LUT_BITS bits of the raw value, so a conversion is one
+ * table lookup and one multiply-add.
+ */
+
+#ifndef NAU7802_LUT_H
+#define NAU7802_LUT_H
+
+/* include headers */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define LUT_MAX_POINTS 16	/* calibration points */
+#define LUT_MAX_ORDER 3		/* highest polynomial order */
+#define LUT_BITS 8		/* raw bits used as table index */
+#define LUT_SEGMENTS (1 << LUT_BITS)
+#define LUT_SEG_SHIFT (24 - LUT_BITS)	/* raw bits within a segment */
+#define LUT_PWL 0		/* straight lines between the points */
+#define LUT_POLY 1		/* least squares polynomial */
+
+struct lut_point{
+	int32_t raw;		/* raw ADC value, 24 bit, shift 0 */
+	double load;		/* known load at raw */
+};
+
+struct lut_cal{
+	int npoints;		/* points added */
+	struct lut_point point[LUT_MAX_POINTS];
+	int model;		/* LUT_PWL or LUT_POLY */
+	int order;		/* polynomial order */
+	double coef[LUT_MAX_ORDER + 1];	/* polynomial in raw / 2^23 */
+	double offset;		/* tare, subtracted from every load */
+	double base[LUT_SEGMENTS];	/* load at the start of each segment */
+	double slope[LUT_SEGMENTS];	/* load per count in each segment */
+};
+
+void NAU7802_lutInit(struct lut_cal *lut);
+
+int NAU7802_lutAddPoint(struct lut_cal *lut, int32_t raw, double load);
+
+int NAU7802_lutFit(struct lut_cal *lut, int model, int order);
+
+double NAU7802_lutLoad(const struct lut_cal *lut, int32_t raw);
+
+void NAU7802_lutLoadBlock(const struct lut_cal *lut, const int32_t *raw,
+		double *load, int n);
+
+double NAU7802_lutTare(struct lut_cal *lut, int32_t raw);
+
+double NAU7802_lutMaxError(const struct lut_cal *lut);
+
+int NAU7802_lutSave(const struct lut_cal *lut, const char *path);
+
+int NAU7802_lutRestore(struct lut_cal *lut, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,441 @@
+/*
+ * Multi-sensor manager.  All NAU7802s use address 0x2A, so
+ * more than one chip per bus needs a TCA9548A mux.  Each bus
+ * gets its own worker thread because transactions on
+ * different buses can run in parallel, while sensors on one
+ * bus always share it.  A worker does not poll its sensors
+ * in turn; it predicts when each one will have a conversion
+ * ready (NAU7802_sched.c), sleeps until the earliest, and
+ * reads it just after it is ready.  When two sensors are due
+ * together the one on the selected mux channel goes first.
+ *
+ * Every sample is numbered by conversion and timed by the
+ * drift fit of its sensor (NAU7802_drift.c), from the ready
+ * time the prediction estimates.  Once a fit has a full window
+ * its period replaces the CRS period of the prediction, so
+ * sensors with different oscillators stay aligned.
+ */
+
+/* include headers */
+#include "NAU7802_mgr.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+/*
+ * Select a mux channel on a bus, or disable all channels
+ * for MGR_NO_MUX.  Nothing is written if the channel is
+ * already selected.  Bus lock must be held.
+ *
+ * Return 1 if the mux was written, else 0.
+ */
+static int
+select_channel(struct mgr_bus *b, int channel){
+	if(b->mux_fd < 0 || b->channel == channel)
+		return 0;
+	wiringPiI2CWrite(b->mux_fd, channel == MGR_NO_MUX ? 0 : 1 << channel);
+	b->channel = channel;
+	return 1;
+}
+
+/*
+ * Queue a sample for consumers and update stats.
+ */
+static void
+push_sample(struct nau7802_mgr *mgr, struct mgr_sample *s){
+	struct mgr_stats *st = &mgr->sensor[s->sensor].stats;
+	pthread_mutex_lock(&mgr->lock);
+	if(mgr->head - mgr->tail >= MGR_QUEUE_LEN)
+		st->dropped++;
+	else{
+		mgr->queue[mgr->head % MGR_QUEUE_LEN] = *s;
+		mgr->head++;
+		st->samples++;
+		pthread_cond_signal(&mgr->cond);
+	}
+	st->last_ns = s->t_ns;
+	pthread_mutex_unlock(&mgr->lock);
+}
+
+/*
+ * Check one sensor for a conversion and read it.
+ *
+ * Return 1 if a sample was read, else 0.
+ */
+static int
+poll_sensor(struct nau7802_mgr *mgr, struct mgr_bus *b, int i){
+	struct mgr_sensor *ms = &mgr->sensor[i];
+	struct nau7802_stats *prev;
+	struct mgr_sample s;
+	uint32_t conv;
+	int switched, ready;
+
+	pthread_mutex_lock(&b->lock);
+	switched = select_channel(b, ms->channel);
+	/* the bus fd is shared, count into the sensor */
+	prev = NAU7802_bindStats(&ms->dev.stats);
+	ready = NAU7802_CR(b->fd);
+	if(ready){
+		s.raw = NAU7802_readADC(b->fd);
+		b->samples++;
+	}
+	s.t_ns = NAU7802_getTimestamp();
+	NAU7802_bindStats(prev);
+	pthread_mutex_unlock(&b->lock);
+
+	if(ready){
+		NAU7802_schedReady(&ms->sched, s.t_ns);
+		s.status = NAU7802_seqUpdate(&ms->seq, ms->sched.ready_ns,
+				s.t_ns, &conv);
+		if(s.status & SAMPLE_DUP)
+			s.t_conv_ns = NAU7802_driftTime(&ms->drift, conv);
+		else
+			s.t_conv_ns = NAU7802_driftUpdate(&ms->drift, conv,
+					ms->sched.ready_ns);
+		if(ms->drift.n >= DRIFT_WINDOW){
+			ms->seq.period_ns = (uint64_t)ms->drift.period_ns;
+			ms->sched.period_ns = ms->seq.period_ns;
+		}
+		s.sensor = i;
+		NAU7802_devLock(&ms->dev);
+		s.load = NAU7802_getLoadFromADC(&ms->dev.lc, s.raw);
+		NAU7802_devUnlock(&ms->dev);
+	}
+	else
+		NAU7802_schedNotReady(&ms->sched, s.t_ns);
+
+	pthread_mutex_lock(&mgr->lock);
+	ms->stats.mux_switches += switched;
+	ms->stats.not_ready += !ready;
+	ms->stats.period_ns = ms->sched.period_ns;
+	ms->stats.lat_avg_ns = NAU7802_schedLatency(&ms->sched);
+	ms->stats.lat_max_ns = ms->sched.lat_max_ns;
+	ms->stats.rate = NAU7802_driftRate(&ms->drift);
+	ms->stats.ppm = NAU7802_driftPPM(&ms->drift);
+	pthread_mutex_unlock(&mgr->lock);
+
+	if(ready)
+		push_sample(mgr, &s);
+	return ready;
+}
+
+/*
+ * Find the sensor on a bus that is due first.  A sensor
+ * on the selected channel wins if it is due within
+ * MGR_SWITCH_SLACK_NS of the earliest.
+ *
+ * Return the sensor index.
+ */
+static int
+pick_sensor(struct nau7802_mgr *mgr, struct mgr_bus *b){
+	struct mgr_sensor *ms;
+	uint64_t due;
+	int k, i, best;
+	best = b->sensor[0];
+	for(k=1; k<b->nsensors; k++){
+		i = b->sensor[k];
+		if(mgr->sensor[i].sched.next_ns < mgr->sensor[best].sched.next_ns)
+			best = i;
+	}
+	due = mgr->sensor[best].sched.next_ns + MGR_SWITCH_SLACK_NS;
+	for(k=0; k<b->nsensors; k++){
+		ms = &mgr->sensor[b->sensor[k]];
+		if(ms->channel == b->channel && ms->sched.next_ns <= due)
+			return b->sensor[k];
+	}
+	return best;
+}
+
+static void *
+bus_worker(void *arg){
+	struct mgr_bus *b = arg;
+	struct nau7802_mgr *mgr = b->mgr;
+	struct timespec ts;
+	uint64_t now, due;
+	int k, i;
+
+	now = NAU7802_getTimestamp();
+	for(k=0; k<b->nsensors; k++){
+		i = b->sensor[k];
+		NAU7802_schedInit(&mgr->sensor[i].sched, mgr->sensor[i].dev.rate, now);
+		NAU7802_seqInit(&mgr->sensor[i].seq, mgr->sensor[i].dev.rate);
+		NAU7802_driftInit(&mgr->sensor[i].drift, mgr->sensor[i].dev.rate);
+	}
+	pthread_mutex_lock(&b->lock);
+	b->start_ns = now;
+	b->samples = 0;
+	pthread_mutex_unlock(&b->lock);
+	while(atomic_load(&mgr->run)){
+		i = pick_sensor(mgr, b);
+		due = mgr->sensor[i].sched.next_ns;
+		now = NAU7802_getTimestamp();
+		if(due > now){
+			if(due - now > MGR_MAX_SLEEP_NS){
+				due = now + MGR_MAX_SLEEP_NS;
+				i = -1;
+			}
+			ts.tv_sec = due / 1000000000ULL;
+			ts.tv_nsec = due % 1000000000ULL;
+			while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+			if(i == -1)
+				continue;
+		}
+		poll_sensor(mgr, b, i);
+	}
+	return NULL;
+}
+
+/*
+ * Set up an empty manager.
+ */
+void
+NAU7802_mgrInit(struct nau7802_mgr *mgr){
+	pthread_condattr_t attr;
+	memset(mgr, 0, sizeof(*mgr));
+	pthread_mutex_init(&mgr->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&mgr->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	atomic_init(&mgr->run, 0);
+}
+
+/*
+ * Open an I2C bus such as "/dev/i2c-1".  mux_addr is the
+ * address of a TCA9548A on the bus, usually TCA9548A_ADDR,
+ * or MGR_NO_MUX.
+ *
+ * Return the bus index or -1 on failure.
+ */
+int
+NAU7802_mgrAddBus(struct nau7802_mgr *mgr, const char *bus, int mux_addr){
+	struct mgr_bus *b;
+	if(mgr->nbuses >= MGR_MAX_BUSES || bus == NULL ||
+		strlen(bus) >= DEV_BUS_LEN)
+		return -1;
+	b = &mgr->bus[mgr->nbuses];
+	memset(b, 0, sizeof(*b));
+	strcpy(b->name, bus);
+	b->mgr = mgr;
+	b->mux_fd = -1;
+	b->channel = -2;	/* unknown, forces first write */
+	b->fd = wiringPiI2CSetupInterface(bus, NAU7802_ADDR);
+	if(b->fd < 0)
+		return -1;
+	if(mux_addr != MGR_NO_MUX){
+		b->mux_fd = wiringPiI2CSetupInterface(bus, mux_addr);
+		if(b->mux_fd < 0){
+			close(b->fd);
+			return -1;
+		}
+	}
+	pthread_mutex_init(&b->lock, NULL);
+	return mgr->nbuses++;
+}
+
+/*
+ * Add a sensor on a bus.  channel is the mux channel 0-7
+ * or MGR_NO_MUX for a chip wired to the bus directly.
+ * A bus with a mux takes muxed sensors only, a chip wired
+ * next to the mux would answer on every channel.
+ *
+ * Return the sensor index or -1 on invalid arguments.
+ */
+int
+NAU7802_mgrAddSensor(struct nau7802_mgr *mgr, int bus, int channel){
+	struct mgr_bus *b;
+	int i, k;
+	if(mgr->nsensors >= MGR_MAX_SENSORS || bus < 0 || bus >= mgr->nbuses)
+		return -1;
+	b = &mgr->bus[bus];
+	if(channel == MGR_NO_MUX && b->mux_fd >= 0)
+		return -1;
+	if(channel != MGR_NO_MUX &&
+		(b->mux_fd < 0 || channel < 0 || channel >= TCA9548A_CHANNELS))
+		return -1;
+	for(k=0; k<b->nsensors; k++)
+		if(mgr->sensor[b->sensor[k]].channel == channel)
+			return -1;	/* same address on same channel */
+
+	i = mgr->nsensors++;
+	mgr->sensor[i].bus = bus;
+	mgr->sensor[i].channel = channel;
+	NAU7802_devAttach(&mgr->sensor[i].dev, b->fd);
+	strcpy(mgr->sensor[i].dev.bus, b->name);
+	memset(&mgr->sensor[i].stats, 0, sizeof(struct mgr_stats));
+
+	/* keep bus list in channel order */
+	for(k=b->nsensors; k>0 && mgr->sensor[b->sensor[k-1]].channel > channel; k--)
+		b->sensor[k] = b->sensor[k-1];
+	b->sensor[k] = i;
+	b->nsensors++;
+	return i;
+}
+
+/*
+ * Configure and calibrate a sensor with
+ * NAU7802_devConfigure.  Blocks the bus for the
+ * few seconds this takes.  Call before NAU7802_mgrStart,
+ * the workers take the rate from here when they start.
+ *
+ * Return as NAU7802_devConfigure or -4 on
+ * invalid sensor.
+ */
+int
+NAU7802_mgrConfigure(struct nau7802_mgr *mgr, int sensor, int gain,
+		uint8_t rate, int ldo){
+	struct mgr_bus *b;
+	int z;
+	if(sensor < 0 || sensor >= mgr->nsensors)
+		return -4;
+	b = &mgr->bus[mgr->sensor[sensor].bus];
+	pthread_mutex_lock(&b->lock);
+	select_channel(b, mgr->sensor[sensor].channel);
+	z = NAU7802_devConfigure(&mgr->sensor[sensor].dev, gain, rate, ldo);
+	pthread_mutex_unlock(&b->lock);
+	return z;
+}
+
+/*
+ * Get the load calibration of a sensor.  Change it
+ * before NAU7802_mgrStart or while holding the lock
+ * of the sensor dev.
+ *
+ * Return the load_cal or NULL on invalid sensor.
+ */
+struct load_cal *
+NAU7802_mgrLoadCal(struct nau7802_mgr *mgr, int sensor){
+	if(sensor < 0 || sensor >= mgr->nsensors)
+		return NULL;
+	return &mgr->sensor[sensor].dev.lc;
+}
+
+/*
+ * Start one worker per bus with sensors.
+ *
+ * Return 0 on success or -1 on failure.
+ */
+int
+NAU7802_mgrStart(struct nau7802_mgr *mgr){
+	int i, j;
+	atomic_store(&mgr->run, 1);
+	for(i=0; i<mgr->nbuses; i++){
+		if(mgr->bus[i].nsensors == 0)
+			continue;
+		if(pthread_create(&mgr->bus[i].worker, NULL, bus_worker,
+				&mgr->bus[i]) != 0){
+			atomic_store(&mgr->run, 0);
+			for(j=0; j<i; j++)
+				if(mgr->bus[j].nsensors)
+					pthread_join(mgr->bus[j].worker, NULL);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Stop all workers and wake any waiting consumer.
+ */
+void
+NAU7802_mgrStop(struct nau7802_mgr *mgr){
+	int i;
+	if(!atomic_exchange(&mgr->run, 0))
+		return;
+	for(i=0; i<mgr->nbuses; i++)
+		if(mgr->bus[i].nsensors)
+			pthread_join(mgr->bus[i].worker, NULL);
+	pthread_mutex_lock(&mgr->lock);
+	pthread_cond_broadcast(&mgr->cond);
+	pthread_mutex_unlock(&mgr->lock);
+}
+
+/*
+ * Take the oldest sample from any sensor.  Waits up to
+ * timeout_ms, 0 does not wait and -1 waits forever.
+ *
+ * Return 1 if a sample was copied to s, else 0.
+ */
+int
+NAU7802_mgrGetSample(struct nau7802_mgr *mgr, struct mgr_sample *s,
+		int timeout_ms){
+	struct timespec ts;
+	int got=0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+	if(ts.tv_nsec >= 1000000000L){
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	pthread_mutex_lock(&mgr->lock);
+	while(mgr->head == mgr->tail && timeout_ms != 0 && atomic_load(&mgr->run)){
+		if(timeout_ms < 0)
+			pthread_cond_wait(&mgr->cond, &mgr->lock);
+		else if(pthread_cond_timedwait(&mgr->cond, &mgr->lock, &ts) != 0)
+			break;
+	}
+	if(mgr->head != mgr->tail){
+		*s = mgr->queue[mgr->tail % MGR_QUEUE_LEN];
+		mgr->tail++;
+		got = 1;
+	}
+	pthread_mutex_unlock(&mgr->lock);
+	return got;
+}
+
+/*
+ * Copy the stats of one sensor.
+ */
+void
+NAU7802_mgrGetStats(struct nau7802_mgr *mgr, int sensor,
+		struct mgr_stats *st){
+	memset(st, 0, sizeof(*st));
+	if(sensor < 0 || sensor >= mgr->nsensors)
+		return;
+	pthread_mutex_lock(&mgr->lock);
+	*st = mgr->sensor[sensor].stats;
+	pthread_mutex_unlock(&mgr->lock);
+}
+
+/*
+ * Get the samples per second read from all sensors
+ * on a bus since the manager started.
+ *
+ * Return the rate or 0 on invalid bus.
+ */
+double
+NAU7802_mgrGetBusRate(struct nau7802_mgr *mgr, int bus){
+	uint64_t now, start;
+	uint32_t samples;
+	if(bus < 0 || bus >= mgr->nbuses)
+		return 0.0;
+	pthread_mutex_lock(&mgr->bus[bus].lock);
+	start = mgr->bus[bus].start_ns;
+	samples = mgr->bus[bus].samples;
+	pthread_mutex_unlock(&mgr->bus[bus].lock);
+	now = NAU7802_getTimestamp();
+	if(start == 0 || now <= start)
+		return 0.0;
+	return samples * 1e9 / (double)(now - start);
+}
+
+/*
+ * Stop the workers and close all buses.
+ */
+void
+NAU7802_mgrClose(struct nau7802_mgr *mgr){
+	int i;
+	NAU7802_mgrStop(mgr);
+	for(i=0; i<mgr->nsensors; i++)
+		NAU7802_devClose(&mgr->sensor[i].dev);
+	for(i=0; i<mgr->nbuses; i++){
+		close(mgr->bus[i].fd);
+		if(mgr->bus[i].mux_fd >= 0)
+			close(mgr->bus[i].mux_fd);
+		pthread_mutex_destroy(&mgr->bus[i].lock);
+	}
+	mgr->nsensors = 0;
+	mgr->nbuses = 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Header for the multi-sensor manager.  The manager opens
+ * several I2C buses, optionally reaches sensors through a
+ * TCA9548A mux on each bus, runs one acquisition thread per
+ * bus and delivers samples from all sensors through one
+ * queue.
+ */
+
+#ifndef NAU7802_MGR_H
+#define NAU7802_MGR_H
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_dev.h"
+#include "NAU7802_sched.h"
+#include "NAU7802_seq.h"
+#include "NAU7802_drift.h"
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* define macros */
+#define MGR_MAX_BUSES 4		/* I2C buses per manager */
+#define MGR_MAX_SENSORS 16	/* sensors per manager */
+#define MGR_QUEUE_LEN 1024	/* samples waiting for consumers */
+#define MGR_NO_MUX -1		/* bus or sensor without a mux */
+#define TCA9548A_ADDR 0x70	/* default mux i2c address */
+#define TCA9548A_CHANNELS 8	/* channels per mux */
+#define MGR_SWITCH_SLACK_NS 100000ULL	/* prefer selected channel if due this close */
+#define MGR_MAX_SLEEP_NS 20000000ULL	/* longest worker sleep, bounds stop time */
+
+struct mgr_sample{
+	int sensor;		/* index from NAU7802_mgrAddSensor */
+	int32_t raw;		/* raw ADC value */
+	double load;		/* linear load */
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of read */
+	uint64_t t_conv_ns;	/* fitted time of the conversion */
+	uint32_t status;	/* SAMPLE_ bits of the conversion numbering */
+};
+
+struct mgr_stats{
+	uint32_t samples;	/* samples delivered */
+	uint32_t not_ready;	/* CR polls without a conversion */
+	uint32_t dropped;	/* samples lost to a full queue */
+	uint32_t mux_switches;	/* mux writes for this sensor */
+	uint64_t last_ns;	/* time of last sample */
+	uint64_t period_ns;	/* observed conversion period */
+	uint64_t lat_avg_ns;	/* mean latency from ready to read */
+	uint64_t lat_max_ns;	/* largest latency from ready to read */
+	double rate;		/* fitted conversion rate in SPS */
+	double ppm;		/* fitted rate error against CRS */
+};
+
+struct mgr_sensor{
+	int bus;		/* index from NAU7802_mgrAddBus */
+	int channel;		/* mux channel or MGR_NO_MUX */
+	struct nau7802_dev dev;	/* handle sharing the bus fd */
+	struct mgr_stats stats;	/* updated by the bus worker */
+	struct sched_entry sched;	/* owned by the bus worker */
+	struct seq_track seq;	/* conversion numbering, owned by the bus worker */
+	struct drift_est drift;	/* conversion clock fit, owned by the bus worker */
+};
+
+struct nau7802_mgr;
+
+struct mgr_bus{
+	char name[DEV_BUS_LEN];	/* bus device, e.g. /dev/i2c-1 */
+	int fd;			/* fd for NAU7802_ADDR on this bus */
+	int mux_fd;		/* fd for the mux or -1 */
+	int channel;		/* mux channel selected, -1 for none */
+	int sensor[MGR_MAX_SENSORS];	/* sensors in channel order */
+	int nsensors;
+	pthread_mutex_t lock;	/* serializes bus transactions */
+	uint64_t start_ns;	/* worker start time, under lock */
+	uint32_t samples;	/* samples read on this bus, under lock */
+	pthread_t worker;
+	struct nau7802_mgr *mgr;
+};
+
+struct nau7802_mgr{
+	struct mgr_bus bus[MGR_MAX_BUSES];
+	int nbuses;
+	struct mgr_sensor sensor[MGR_MAX_SENSORS];
+	int nsensors;
+	struct mgr_sample queue[MGR_QUEUE_LEN];
+	unsigned int head;	/* samples queued */
+	unsigned int tail;	/* samples taken */
+	pthread_mutex_t lock;	/* protects queue and stats */
+	pthread_cond_t cond;	/* signalled on new samples */
+	atomic_int run;		/* workers running */
+};
+
+void NAU7802_mgrInit(struct nau7802_mgr *mgr);
+
+int NAU7802_mgrAddBus(struct nau7802_mgr *mgr, const char *bus, int mux_addr);
+
+int NAU7802_mgrAddSensor(struct nau7802_mgr *mgr, int bus, int channel);
+
+int NAU7802_mgrConfigure(struct nau7802_mgr *mgr, int sensor, int gain,
+		uint8_t rate, int ldo);
+
+struct load_cal *NAU7802_mgrLoadCal(struct nau7802_mgr *mgr, int sensor);
+
+int NAU7802_mgrStart(struct nau7802_mgr *mgr);
+
+void NAU7802_mgrStop(struct nau7802_mgr *mgr);
+
+int NAU7802_mgrGetSample(struct nau7802_mgr *mgr, struct mgr_sample *s,
+		int timeout_ms);
+
+void NAU7802_mgrGetStats(struct nau7802_mgr *mgr, int sensor,
+		struct mgr_stats *st);
+
+double NAU7802_mgrGetBusRate(struct nau7802_mgr *mgr, int bus);
+
+void NAU7802_mgrClose(struct nau7802_mgr *mgr);
+
+#endif
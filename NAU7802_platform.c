@@ -0,0 +1,201 @@
+/*
+ * Platform aggregation.  Summing the latest reading of every
+ * cell mixes loads taken up to a conversion period apart, so
+ * a load moving across the platform shows up as an error
+ * that depends on the corner.  Here every output is computed
+ * for one instant: each cell is linearly interpolated between
+ * the two loads around the grid time.  Outputs lag real time
+ * by delay_ns so all cells have a load after the grid time;
+ * delay_ms of one conversion period plus the read latency is
+ * enough and is the only latency added.
+ */
+
+/* include headers */
+#include "NAU7802_platform.h"
+#include <string.h>
+#include <math.h>
+
+#define PLAT_MASK (PLAT_HIST_LEN - 1)
+
+/*
+ * Interpolate a cell at grid time t_ns.
+ *
+ * Return 1 if the cell had loads on both sides of
+ * t_ns, 0 if the nearest load was used instead.
+ */
+static int
+cell_at(struct plat_cell *c, uint64_t t_ns, double *load){
+	uint32_t i, n, a, b;
+	double f;
+	n = c->head < PLAT_HIST_LEN ? c->head : PLAT_HIST_LEN;
+	if(n == 0){
+		*load = 0.0;
+		return 0;
+	}
+	/* newest load at or before t_ns */
+	for(i=1; i<=n; i++)
+		if(c->t_ns[(c->head - i) & PLAT_MASK] <= t_ns)
+			break;
+	if(i == 1 || i > n){
+		/* no newer load, or grid time older than history */
+		*load = c->load[(c->head - (i > n ? n : 1)) & PLAT_MASK];
+		return 0;
+	}
+	a = (c->head - i) & PLAT_MASK;
+	b = (c->head - i + 1) & PLAT_MASK;
+	f = (double)(t_ns - c->t_ns[a]) / (double)(c->t_ns[b] - c->t_ns[a]);
+	*load = c->load[a] + f * (c->load[b] - c->load[a]);
+	return 1;
+}
+
+/*
+ * Set up a platform of ncells cells giving rate_hz
+ * outputs per second, delay_ms behind real time.
+ *
+ * Return 0 on success or -1 on invalid arguments.
+ */
+int
+NAU7802_platformInit(struct platform *pf, int ncells, int rate_hz,
+		int delay_ms){
+	int i;
+	if(ncells < 1 || ncells > PLAT_MAX_CELLS || rate_hz <= 0 || delay_ms < 0)
+		return -1;
+	memset(pf, 0, sizeof(*pf));
+	pf->ncells = ncells;
+	pf->period_ns = 1000000000ULL / rate_hz;
+	pf->delay_ns = (uint64_t)delay_ms * 1000000ULL;
+	for(i=0; i<ncells; i++)
+		pf->cell[i].gain = 1.0;
+	return 0;
+}
+
+/*
+ * Add a load of one cell.  Loads of a cell must be
+ * pushed in time order.
+ *
+ * Return 0 on success or -1 on invalid cell or
+ * out of order time.
+ */
+int
+NAU7802_platformPush(struct platform *pf, int cell, double load,
+		uint64_t t_ns){
+	struct plat_cell *c;
+	if(cell < 0 || cell >= pf->ncells)
+		return -1;
+	c = &pf->cell[cell];
+	if(c->head && c->t_ns[(c->head - 1) & PLAT_MASK] >= t_ns)
+		return -1;
+	c->load[c->head & PLAT_MASK] = load;
+	c->t_ns[c->head & PLAT_MASK] = t_ns;
+	c->head++;
+	return 0;
+}
+
+/*
+ * Make the next output if its grid time is at least
+ * delay_ns before now_ns.  Call until it returns 0.
+ *
+ * Return 1 with the summed load in sum and the grid
+ * time in t_ns, or 0 if no output is due.
+ */
+int
+NAU7802_platformOutput(struct platform *pf, uint64_t now_ns,
+		double *sum, uint64_t *t_ns){
+	double load, s=0.0;
+	int i, held=0;
+	if(now_ns < pf->delay_ns)
+		return 0;
+	if(pf->next_ns == 0)
+		pf->next_ns = (now_ns - pf->delay_ns) / pf->period_ns * pf->period_ns;
+	if(pf->next_ns + pf->delay_ns > now_ns)
+		return 0;
+	for(i=0; i<pf->ncells; i++){
+		if(!cell_at(&pf->cell[i], pf->next_ns, &load))
+			held = 1;
+		s += pf->cell[i].gain * load;
+	}
+	*sum = s;
+	*t_ns = pf->next_ns;
+	pf->next_ns += pf->period_ns;
+	pf->outputs++;
+	pf->held += held;
+	return 1;
+}
+
+/*
+ * Start a new corner calibration.
+ */
+void
+NAU7802_platformCalReset(struct platform *pf){
+	memset(pf->ata, 0, sizeof(pf->ata));
+	memset(pf->atb, 0, sizeof(pf->atb));
+	pf->cal_rows = 0;
+}
+
+/*
+ * Add one placement of a known load to the corner
+ * calibration.  cell_load holds the tared, averaged load
+ * of every cell with the known load on the platform.  Put
+ * the load near each corner in turn, and preferably a few
+ * more places, so there are at least ncells placements.
+ *
+ * Return the number of placements added.
+ */
+int
+NAU7802_platformCalAdd(struct platform *pf, const double *cell_load,
+		double known){
+	int i, j;
+	for(i=0; i<pf->ncells; i++){
+		for(j=0; j<pf->ncells; j++)
+			pf->ata[i][j] += cell_load[i] * cell_load[j];
+		pf->atb[i] += cell_load[i] * known;
+	}
+	return ++pf->cal_rows;
+}
+
+/*
+ * Solve the corner gains that make the summed load match
+ * the known loads in the least squares sense, and use them
+ * for the following outputs.
+ *
+ * Return 0 on success or -1 if there were too few or
+ * too similar placements.
+ */
+int
+NAU7802_platformCalSolve(struct platform *pf){
+	double a[PLAT_MAX_CELLS][PLAT_MAX_CELLS + 1], f, t;
+	int n = pf->ncells, i, j, k, p;
+	if(pf->cal_rows < n)
+		return -1;
+	for(i=0; i<n; i++){
+		for(j=0; j<n; j++)
+			a[i][j] = pf->ata[i][j];
+		a[i][n] = pf->atb[i];
+	}
+	/* gaussian elimination with partial pivoting */
+	for(k=0; k<n; k++){
+		p = k;
+		for(i=k+1; i<n; i++)
+			if(fabs(a[i][k]) > fabs(a[p][k]))
+				p = i;
+		if(fabs(a[p][k]) < 1e-12)
+			return -1;
+		for(j=k; j<=n; j++){
+			t = a[k][j];
+			a[k][j] = a[p][j];
+			a[p][j] = t;
+		}
+		for(i=k+1; i<n; i++){
+			f = a[i][k] / a[k][k];
+			for(j=k; j<=n; j++)
+				a[i][j] -= f * a[k][j];
+		}
+	}
+	for(i=n-1; i>=0; i--){
+		t = a[i][n];
+		for(j=i+1; j<n; j++)
+			t -= a[i][j] * pf->cell[j].gain;
+		pf->cell[i].gain = t / a[i][i];
+	}
+	return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Header for platform aggregation.  Loads from the cells of
+ * one platform scale, each read by its own NAU7802 at its
+ * own instants, are interpolated onto a common time grid,
+ * scaled by a per-corner gain and summed at a fixed rate.
+ *
+ * Typical use with the multi-sensor manager: push every
+ * mgr_sample with NAU7802_platformPush at its t_conv_ns, the
+ * fitted conversion time, then call NAU7802_platformOutput
+ * until it returns 0.
+ */
+
+#ifndef NAU7802_PLATFORM_H
+#define NAU7802_PLATFORM_H
+
+/* include headers */
+#include <stdint.h>
+
+/* define macros */
+#define PLAT_MAX_CELLS 16	/* load cells per platform, as MGR_MAX_SENSORS */
+#define PLAT_HIST_LEN 64	/* samples kept per cell, power of 2 */
+
+struct plat_cell{
+	double load[PLAT_HIST_LEN];	/* recent loads */
+	uint64_t t_ns[PLAT_HIST_LEN];	/* CLOCK_MONOTONIC time of each load */
+	uint32_t head;			/* loads pushed */
+	double gain;			/* corner gain, 1.0 until calibrated */
+};
+
+struct platform{
+	int ncells;
+	struct plat_cell cell[PLAT_MAX_CELLS];
+	uint64_t period_ns;	/* output period */
+	uint64_t delay_ns;	/* output lag behind real time */
+	uint64_t next_ns;	/* grid time of next output */
+	uint32_t outputs;	/* outputs made */
+	uint32_t held;		/* outputs where a cell had no newer load */
+	double ata[PLAT_MAX_CELLS][PLAT_MAX_CELLS];	/* corner cal normal equations */
+	double atb[PLAT_MAX_CELLS];
+	int cal_rows;		/* corner cal placements added */
+};
+
+int NAU7802_platformInit(struct platform *pf, int ncells, int rate_hz,
+		int delay_ms);
+
+int NAU7802_platformPush(struct platform *pf, int cell, double load,
+		uint64_t t_ns);
+
+int NAU7802_platformOutput(struct platform *pf, uint64_t now_ns,
+		double *sum, uint64_t *t_ns);
+
+void NAU7802_platformCalReset(struct platform *pf);
+
+int NAU7802_platformCalAdd(struct platform *pf, const double *cell_load,
+		double known);
+
+int NAU7802_platformCalSolve(struct platform *pf);
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Recording and replay of raw sample streams.  The file is
+ * a struct rec_header followed by struct rec_sample records,
+ * written with stdio buffering so recording at 320 SPS costs
+ * one write call every few hundred samples.
+ */
+
+/* include headers */
+#include "NAU7802_record.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+/*
+ * Create a recording at path, replacing any file,
+ * for samples read at rate, a CRS_ macro, and gain.
+ *
+ * Return 0 or -1 on failure.
+ */
+int
+NAU7802_recOpen(struct rec_file *rf, const char *path, uint8_t rate, int gain){
+	memset(rf, 0, sizeof(*rf));
+	strcpy(rf->hdr.magic, REC_MAGIC);
+	rf->hdr.version = REC_VERSION;
+	rf->hdr.rate = rate;
+	rf->hdr.gain = gain;
+	rf->fp = fopen(path, "wb");
+	if(rf->fp == NULL)
+		return -1;
+	if(fwrite(&rf->hdr, sizeof(rf->hdr), 1, rf->fp) != 1){
+		fclose(rf->fp);
+		rf->fp = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Append a sample.
+ *
+ * Return 0 or -1 on failure.
+ */
+int
+NAU7802_recWrite(struct rec_file *rf, int32_t raw, uint64_t t_ns, uint32_t status){
+	struct rec_sample s;
+	s.t_ns = t_ns;
+	s.raw = raw;
+	s.status = status;
+	if(fwrite(&s, sizeof(s), 1, rf->fp) != 1)
+		return -1;
+	rf->count++;
+	return 0;
+}
+
+/*
+ * Record the next n conversions of fd.  A
+ * conversion that does not come before
+ * NAU7802_deadline or fails to read is written
+ * with SAMPLE_TIMEOUT or SAMPLE_IO_ERR.
+ *
+ * Return the number of samples written or -1
+ * on a write failure.
+ */
+int
+NAU7802_recordADC(int fd, struct rec_file *rf, int n){
+	uint32_t status;
+	int32_t raw;
+	int i, cr;
+	for(i=0; i<n; i++){
+		raw = 0;
+		status = 0;
+		cr = NAU7802_waitCR(fd, NAU7802_deadline(fd));
+		if(cr == 0)
+			status = SAMPLE_TIMEOUT;
+		else if(cr == -1 || NAU7802_readRaw(fd, &raw) == -1)
+			status = SAMPLE_IO_ERR;
+		if(NAU7802_recWrite(rf, raw, NAU7802_getTimestamp(), status) == -1)
+			return -1;
+	}
+	return n;
+}
+
+/*
+ * Close a recording or replay.
+ *
+ * Return 0 or -1 if buffered samples could not
+ * be written.
+ */
+int
+NAU7802_recClose(struct rec_file *rf){
+	int z=0;
+	if(rf->fp != NULL && fclose(rf->fp) != 0)
+		z = -1;
+	rf->fp = NULL;
+	return z;
+}
+
+/*
+ * Open a recording for replay.
+ *
+ * Return 0 or -1 on failure or a bad header.
+ */
+int
+NAU7802_replayOpen(struct rec_file *rf, const char *path){
+	memset(rf, 0, sizeof(*rf));
+	rf->fp = fopen(path, "rb");
+	if(rf->fp == NULL)
+		return -1;
+	if(fread(&rf->hdr, sizeof(rf->hdr), 1, rf->fp) != 1 ||
+		strncmp(rf->hdr.magic, REC_MAGIC, sizeof(rf->hdr.magic)) != 0 ||
+		rf->hdr.version != REC_VERSION){
+		fclose(rf->fp);
+		rf->fp = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Get the next sample of a replay.  With speed 0
+ * it returns at once; otherwise it sleeps so the
+ * samples come at speed times the recorded rate,
+ * e.g. 1.0 for real time.
+ *
+ * Return 1 if s was set or 0 at the end.
+ */
+int
+NAU7802_replayNext(struct rec_file *rf, struct rec_sample *s, double speed){
+	struct timespec ts;
+	uint64_t due;
+	if(fread(s, sizeof(*s), 1, rf->fp) != 1)
+		return 0;
+	if(rf->count++ == 0){
+		rf->first_ns = s->t_ns;
+		rf->start_ns = NAU7802_getTimestamp();
+	}
+	if(speed > 0.0){
+		due = rf->start_ns + (uint64_t)((s->t_ns - rf->first_ns) / speed);
+		ts.tv_sec = due / 1000000000ULL;
+		ts.tv_nsec = due % 1000000000ULL;
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+	}
+	return 1;
+}
+
+/*
+ * Read a whole recording into an array allocated
+ * with malloc, to be freed by the caller.  hdr may
+ * be NULL.
+ *
+ * Return the number of samples or -1 on failure.
+ */
+long
+NAU7802_replayLoad(const char *path, struct rec_header *hdr,
+		struct rec_sample **out){
+	struct rec_file rf;
+	struct rec_sample *s;
+	long size, n;
+
+	if(NAU7802_replayOpen(&rf, path) == -1)
+		return -1;
+	if(fseek(rf.fp, 0, SEEK_END) == -1 || (size = ftell(rf.fp)) == -1 ||
+		fseek(rf.fp, sizeof(rf.hdr), SEEK_SET) == -1){
+		NAU7802_recClose(&rf);
+		return -1;
+	}
+	n = (size - (long)sizeof(rf.hdr)) / (long)sizeof(*s);
+	s = malloc((n > 0 ? n : 1) * sizeof(*s));
+	if(s == NULL){
+		NAU7802_recClose(&rf);
+		return -1;
+	}
+	n = fread(s, sizeof(*s), n, rf.fp);
+	if(hdr)
+		*hdr = rf.hdr;
+	NAU7802_recClose(&rf);
+	*out = s;
+	return n;
+}
@@ -0,0 +1,68 @@
+/*
+ * Header for recording and replaying raw sample streams.  A
+ * recording keeps every raw value at shift 0 with its time
+ * and status, so a replay can feed the same load and filter
+ * functions as a live sensor, as fast as the CPU allows or
+ * paced at any speed, and give the same results every time.
+ */
+
+#ifndef NAU7802_RECORD_H
+#define NAU7802_RECORD_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define REC_MAGIC "NAU7802REC"
+#define REC_VERSION 1
+
+/* file header, native byte order */
+struct rec_header{
+	char magic[12];		/* REC_MAGIC */
+	uint32_t version;	/* REC_VERSION */
+	uint32_t rate;		/* CRS_ macro of the recording */
+	int32_t gain;		/* PGA gain 1-128 */
+	uint32_t reserved;
+};
+
+/* one sample, native byte order */
+struct rec_sample{
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of read */
+	int32_t raw;		/* raw ADC value at shift 0 */
+	uint32_t status;	/* SAMPLE_ status bits, 0 when good */
+};
+
+struct rec_file{
+	FILE *fp;
+	struct rec_header hdr;
+	uint64_t count;		/* samples written or replayed */
+	uint64_t first_ns;	/* time of first replayed sample */
+	uint64_t start_ns;	/* when the paced replay started */
+};
+
+int NAU7802_recOpen(struct rec_file *rf, const char *path, uint8_t rate, int gain);
+
+int NAU7802_recWrite(struct rec_file *rf, int32_t raw, uint64_t t_ns, uint32_t status);
+
+int NAU7802_recordADC(int fd, struct rec_file *rf, int n);
+
+int NAU7802_recClose(struct rec_file *rf);
+
+int NAU7802_replayOpen(struct rec_file *rf, const char *path);
+
+int NAU7802_replayNext(struct rec_file *rf, struct rec_sample *s, double speed);
+
+long NAU7802_replayLoad(const char *path, struct rec_header *hdr,
+		struct rec_sample **out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Ready time prediction.  Each sensor starts with the period
+ * of its CRS setting and refines it from the ready times it
+ * observes, since the internal oscillator is not exact.  When
+ * a poll found no conversion the ready time is taken as the
+ * middle of the span from that poll to the read, otherwise
+ * as the prediction clamped to the span since the last read.
+ *
+ * NAU7802_schedWait sleeps until guard_ns before the predicted
+ * ready time and polls SCHED_GUARD_POLLS times across the
+ * guard.  A first poll that is already ready means the wake
+ * was late, and the guard grows by half; a conversion found
+ * after more than two polls means it was early, and the guard
+ * shrinks by an eighth.  So the guard settles just above the
+ * prediction error and a sample costs about two CR polls.
+ */
+
+/* include headers */
+#include "NAU7802_sched.h"
+#include "NAU7802.h"
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+/*
+ * Start predicting for a sensor at rate.  The first
+ * poll is due now.
+ */
+void
+NAU7802_schedInit(struct sched_entry *se, uint8_t rate, uint64_t now_ns){
+	memset(se, 0, sizeof(*se));
+	se->nominal_ns = NAU7802_ratePeriod(rate);
+	if(se->nominal_ns == 0)
+		se->nominal_ns = NAU7802_ratePeriod(CRS_10);
+	se->period_ns = se->nominal_ns;
+	se->guard_ns = se->nominal_ns / SCHED_GUARD_DIV;
+	se->pred_ns = now_ns;
+	se->next_ns = now_ns;
+	se->read_ns = now_ns;
+}
+
+/*
+ * Record a read at t_ns that found a conversion and
+ * predict the next one.
+ *
+ * Return the estimated latency from ready to read.
+ */
+uint64_t
+NAU7802_schedReady(struct sched_entry *se, uint64_t t_ns){
+	uint64_t ready, lat, obs, n;
+
+	if(se->miss_ns > se->read_ns)
+		/* ready between the last miss and now */
+		ready = se->miss_ns + (t_ns - se->miss_ns) / 2;
+	else{
+		/* ready since the last read, best guess the prediction */
+		ready = se->pred_ns;
+		if(ready < se->read_ns)
+			ready = se->read_ns;
+		if(ready > t_ns)
+			ready = t_ns;
+	}
+
+	if(se->samples > 0 && ready > se->ready_ns){
+		obs = ready - se->ready_ns;
+		n = (obs + se->period_ns / 2) / se->period_ns;	/* periods elapsed */
+		if(n > 0){
+			obs /= n;
+			if(obs > se->nominal_ns - se->nominal_ns / 8 &&
+				obs < se->nominal_ns + se->nominal_ns / 8){
+				if(obs > se->period_ns)
+					se->period_ns += (obs - se->period_ns) >> SCHED_EWMA_SHIFT;
+				else
+					se->period_ns -= (se->period_ns - obs) >> SCHED_EWMA_SHIFT;
+			}
+		}
+	}
+
+	lat = t_ns - ready;
+	se->lat_sum_ns += lat;
+	if(lat > se->lat_max_ns)
+		se->lat_max_ns = lat;
+	se->samples++;
+	se->ready_ns = ready;
+	se->read_ns = t_ns;
+	se->pred_ns = ready + se->period_ns;
+	/* a late read may already be past the next conversion */
+	while(se->pred_ns <= t_ns)
+		se->pred_ns += se->period_ns;
+	se->next_ns = se->pred_ns;
+	return lat;
+}
+
+/*
+ * Record a poll at t_ns that found no conversion and
+ * schedule a retry shortly after.
+ */
+void
+NAU7802_schedNotReady(struct sched_entry *se, uint64_t t_ns){
+	uint64_t retry;
+	retry = se->period_ns / SCHED_RETRY_DIV;
+	if(retry < SCHED_MIN_RETRY_NS)
+		retry = SCHED_MIN_RETRY_NS;
+	se->misses++;
+	se->miss_ns = t_ns;
+	if(se->next_ns < t_ns + retry)
+		se->next_ns = t_ns + retry;
+}
+
+/*
+ * Get the mean latency from ready to read.
+ *
+ * Return the latency in ns.
+ */
+uint64_t
+NAU7802_schedLatency(struct sched_entry *se){
+	if(se->samples == 0)
+		return 0;
+	return se->lat_sum_ns / se->samples;
+}
+
+static void
+sched_sleep(uint64_t t_ns, int flags){
+	struct timespec ts;
+	ts.tv_sec = t_ns / 1000000000ULL;
+	ts.tv_nsec = t_ns % 1000000000ULL;
+	/* an absolute time is kept, a relative one becomes the remainder */
+	while(clock_nanosleep(CLOCK_MONOTONIC, flags, &ts, &ts) == EINTR);
+}
+
+/*
+ * Sleep until just before the next predicted
+ * conversion of the NAU7802 on fd and poll CR up
+ * to SCHED_MAX_POLLS times.  The guard adapts to
+ * how late or early the wake was.
+ *
+ * Return 1 when a conversion is ready to read,
+ * 0 if none came, call again then, or -1 if a CR
+ * read failed.
+ */
+int
+NAU7802_schedWait(struct sched_entry *se, int fd){
+	uint64_t now, step, max;
+	int i, cr;
+
+	now = se->next_ns > se->guard_ns ? se->next_ns - se->guard_ns : 0;
+	if(now > NAU7802_getTimestamp())
+		sched_sleep(now, TIMER_ABSTIME);
+	step = se->guard_ns / SCHED_GUARD_POLLS;
+	for(i=0; i<SCHED_MAX_POLLS; i++){
+		se->polls++;
+		cr = NAU7802_pollCR(fd);
+		if(cr == -1)
+			return -1;
+		if(cr == 1){
+			now = NAU7802_getTimestamp();
+			max = se->period_ns / 4;
+			if(i == 0){
+				se->late++;
+				se->guard_ns += se->guard_ns / 2;
+				if(se->guard_ns > max)
+					se->guard_ns = max;
+			}
+			else if(i > 2){
+				se->guard_ns -= se->guard_ns / 8;
+				if(se->guard_ns < SCHED_MIN_GUARD_NS)
+					se->guard_ns = SCHED_MIN_GUARD_NS;
+			}
+			se->waits++;
+			NAU7802_schedReady(se, now);
+			return 1;
+		}
+		NAU7802_schedNotReady(se, NAU7802_getTimestamp());
+		sched_sleep(step, 0);
+	}
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Header for ready time prediction used to schedule reads of
+ * several NAU7802s sharing a bus, and to sleep until just
+ * before the next conversion instead of spinning on CR.
+ */
+
+#ifndef NAU7802_SCHED_H
+#define NAU7802_SCHED_H
+
+/* include headers */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define SCHED_EWMA_SHIFT 4	/* period estimate weight 1/16 */
+#define SCHED_RETRY_DIV 32	/* retry after period/32 when not ready */
+#define SCHED_MIN_RETRY_NS 100000ULL	/* never retry sooner than 100 us */
+#define SCHED_GUARD_DIV 16	/* first guard period/16 */
+#define SCHED_MIN_GUARD_NS 40000ULL	/* guard never below 40 us */
+#define SCHED_GUARD_POLLS 4	/* polls spread over the guard */
+#define SCHED_MAX_POLLS 16	/* polls before NAU7802_schedWait gives up */
+
+struct sched_entry{
+	uint64_t nominal_ns;	/* period from the CRS setting */
+	uint64_t period_ns;	/* observed conversion period */
+	uint64_t pred_ns;	/* predicted next ready time */
+	uint64_t next_ns;	/* time of next poll */
+	uint64_t ready_ns;	/* estimated ready time of last sample */
+	uint64_t read_ns;	/* time of last read */
+	uint64_t miss_ns;	/* last poll that found no conversion */
+	uint32_t samples;	/* samples read */
+	uint32_t misses;	/* polls that found no conversion */
+	uint64_t lat_sum_ns;	/* sum of ready to read latency */
+	uint64_t lat_max_ns;	/* largest ready to read latency */
+	uint64_t guard_ns;	/* NAU7802_schedWait wakes this long before pred_ns */
+	uint32_t waits;		/* NAU7802_schedWait calls that found a conversion */
+	uint32_t polls;		/* CR polls of NAU7802_schedWait */
+	uint32_t late;		/* waits whose first poll was already ready */
+};
+
+void NAU7802_schedInit(struct sched_entry *se, uint8_t rate, uint64_t now_ns);
+
+uint64_t NAU7802_schedReady(struct sched_entry *se, uint64_t t_ns);
+
+void NAU7802_schedNotReady(struct sched_entry *se, uint64_t t_ns);
+
+uint64_t NAU7802_schedLatency(struct sched_entry *se);
+
+int NAU7802_schedWait(struct sched_entry *se, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
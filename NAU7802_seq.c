@@ -0,0 +1,89 @@
+/*
+ * Conversion sequence numbering.  The conversion number only
+ * advances by the periods between two samples, so an error in
+ * the nominal rate of the oscillator adds up over one gap, not
+ * since the start.
+ *
+ * ready_ns is a lower envelope of the times CR was seen.  It
+ * jumps back to a sample seen earlier than predicted and moves
+ * forward 1/2^SEQ_TRACK_SHIFT of the way to a late one, so poll
+ * latency up to half a period does not change the numbering.
+ */
+
+/* include headers */
+#include "NAU7802_seq.h"
+#include <string.h>
+
+/*
+ * Initialize for conversions at rate, one of the
+ * CRS_ macros.  An invalid rate is taken as CRS_10.
+ */
+void
+NAU7802_seqInit(struct seq_track *sq, uint8_t rate){
+	memset(sq, 0, sizeof(*sq));
+	sq->period_ns = NAU7802_ratePeriod(rate);
+	if(sq->period_ns == 0)
+		sq->period_ns = NAU7802_ratePeriod(CRS_10);
+}
+
+/*
+ * Number a sample whose conversion was seen ready at
+ * t_cr_ns and read by t_read_ns.  conv is set to its
+ * conversion number, the first sample being 0.
+ *
+ * Return SAMPLE_GAP, SAMPLE_DUP and SAMPLE_OVERRUN
+ * bits, 0 when good.
+ */
+uint8_t
+NAU7802_seqUpdate(struct seq_track *sq, uint64_t t_cr_ns,
+		uint64_t t_read_ns, uint32_t *conv){
+	uint64_t n, pred;
+	uint8_t flags=0;
+
+	if(sq->samples++ == 0){
+		sq->conv = 0;
+		sq->ready_ns = t_cr_ns;
+	}
+	else{
+		n = t_cr_ns > sq->ready_ns ?
+			(t_cr_ns - sq->ready_ns + sq->period_ns / 2) / sq->period_ns : 0;
+		if(n == 0){
+			sq->dups++;
+			*conv = sq->conv;
+			return SAMPLE_DUP;
+		}
+		if(n > 1){
+			flags |= SAMPLE_GAP;
+			sq->gaps++;
+			sq->missed += n - 1;
+			if(n - 1 > sq->max_gap)
+				sq->max_gap = n - 1;
+		}
+		sq->conv += n;
+		pred = sq->ready_ns + n * sq->period_ns;
+		if(t_cr_ns < pred)
+			sq->ready_ns = t_cr_ns;
+		else
+			sq->ready_ns = pred + ((t_cr_ns - pred) >> SEQ_TRACK_SHIFT);
+	}
+	if(t_read_ns >= sq->ready_ns + sq->period_ns){
+		flags |= SAMPLE_OVERRUN;
+		sq->overruns++;
+	}
+	*conv = sq->conv;
+	return flags;
+}
+
+/*
+ * Get the fraction of conversions since the first
+ * sample that were read.  1.0 means the reader
+ * keeps up with the CRS rate.
+ *
+ * Return the fraction or 0 before the first sample.
+ */
+double
+NAU7802_seqDelivered(const struct seq_track *sq){
+	if(sq->samples == 0)
+		return 0.0;
+	return (double)(sq->conv + 1 - sq->missed) / (sq->conv + 1);
+}
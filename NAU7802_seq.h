@@ -0,0 +1,47 @@
+/*
+ * Header for conversion sequence numbering.  Each sample gets
+ * the number of the conversion it came from, counted from the
+ * time CR was seen and the CRS rate, so a sample can be
+ * flagged when conversions were skipped before it, when it is
+ * a second read of a conversion, or when the next conversion
+ * was already due before it was read.
+ */
+
+#ifndef NAU7802_SEQ_H
+#define NAU7802_SEQ_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define SEQ_TRACK_SHIFT 4	/* ready time follows late samples by 1/16 */
+
+struct seq_track{
+	uint64_t period_ns;	/* conversion period from the CRS rate */
+	uint64_t ready_ns;	/* estimated ready time of last conversion */
+	uint32_t conv;		/* conversion number of last sample */
+	uint32_t samples;	/* samples numbered */
+	uint32_t gaps;		/* samples with conversions missed before them */
+	uint32_t missed;	/* conversions never read */
+	uint32_t max_gap;	/* most conversions missed in one gap */
+	uint32_t dups;		/* conversions read more than once */
+	uint32_t overruns;	/* samples read after the next conversion was due */
+};
+
+void NAU7802_seqInit(struct seq_track *sq, uint8_t rate);
+
+uint8_t NAU7802_seqUpdate(struct seq_track *sq, uint64_t t_cr_ns,
+		uint64_t t_read_ns, uint32_t *conv);
+
+double NAU7802_seqDelivered(const struct seq_track *sq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * Unix domain socket server.  One thread serves all clients
+ * with poll().  Every client has its own cursor into the
+ * stream ring and its own frame buffer, and all sockets are
+ * non-blocking: a client that does not keep up only keeps its
+ * own frame waiting while its cursor falls behind.  When the
+ * ring overwrites its samples the client skips ahead and the
+ * loss is reported in the next frame.  Acquisition and the
+ * other clients are never held up.
+ */
+
+/* accept4 */
+#define _GNU_SOURCE
+
+/* include headers */
+#include "NAU7802_server.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_READ_LEN 64	/* stream samples read at once */
+
+static void
+close_client(struct server_client *c){
+	if(c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+}
+
+/*
+ * Send what is left of the current frame.
+ *
+ * Return 1 if the frame is sent, 0 if the socket is
+ * full or -1 if the client was closed.
+ */
+static int
+flush_client(struct server_client *c){
+	ssize_t r;
+	while(c->out_off < c->out_len){
+		r = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+				MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(r > 0)
+			c->out_off += r;
+		else if(r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		else if(r == -1 && errno == EINTR)
+			continue;
+		else{
+			close_client(c);
+			return -1;
+		}
+	}
+	c->out_len = 0;
+	c->out_off = 0;
+	return 1;
+}
+
+/*
+ * Close the pending records into a frame and send it.
+ *
+ * Return as flush_client.
+ */
+static int
+send_frame(struct server_client *c){
+	struct stream_frame *f = (struct stream_frame *)c->out;
+	f->magic = STREAM_MAGIC;
+	f->count = c->npend;
+	f->decimation = c->decimation;
+	f->lost = c->lost;
+	f->pad = 0;
+	c->out_len = sizeof(*f) + c->npend * sizeof(struct stream_record);
+	c->out_off = 0;
+	c->npend = 0;
+	return flush_client(c);
+}
+
+/*
+ * Move new samples into frames for one client and send
+ * full frames or partial frames older than the client
+ * latency.
+ */
+static void
+service_client(struct nau7802_server *srv, struct server_client *c, uint64_t now){
+	struct stream_sample buf[SERVER_READ_LEN];
+	struct stream_record *rec;
+	uint32_t want;
+	int i, n;
+
+	if(c->out_len && flush_client(c) != 1)
+		return;
+	for(;;){
+		want = (c->batch - c->npend) * c->decimation;
+		if(want > SERVER_READ_LEN)
+			want = SERVER_READ_LEN;
+		n = NAU7802_streamRead(srv->st, &c->cursor, buf, want, &c->lost);
+		if(n == 0)
+			break;
+		rec = (struct stream_record *)(c->out + sizeof(struct stream_frame));
+		for(i=0; i<n; i++){
+			if(c->skip){
+				c->skip--;
+				continue;
+			}
+			c->skip = c->decimation - 1;
+			if(c->npend == 0)
+				c->first_ns = now;
+			rec[c->npend].t_ns = buf[i].t_ns;
+			rec[c->npend].seq = buf[i].seq;
+			rec[c->npend].raw = buf[i].raw;
+			rec[c->npend].load = buf[i].load;
+			c->npend++;
+		}
+		if((uint32_t)c->npend >= c->batch && send_frame(c) != 1)
+			return;
+	}
+	if(c->npend && now - c->first_ns >= c->latency_ns)
+		send_frame(c);
+}
+
+/*
+ * Read a subscribe request.  Bytes after a complete
+ * request are ignored.
+ */
+static void
+read_client(struct server_client *c){
+	unsigned char junk[64];
+	struct stream_subscribe *q = &c->req;
+	ssize_t r;
+	if(c->req_len < sizeof(*q))
+		r = recv(c->fd, (unsigned char *)q + c->req_len,
+				sizeof(*q) - c->req_len, MSG_DONTWAIT);
+	else
+		r = recv(c->fd, junk, sizeof(junk), MSG_DONTWAIT);
+	if(r == 0 || (r == -1 && errno != EAGAIN && errno != EINTR)){
+		close_client(c);
+		return;
+	}
+	if(r < 0 || c->req_len >= sizeof(*q))
+		return;
+	c->req_len += r;
+	if(c->req_len < sizeof(*q) || q->magic != STREAM_MAGIC)
+		return;
+	c->decimation = q->decimation ? q->decimation : 1;
+	if(q->batch >= 1 && q->batch <= STREAM_MAX_BATCH)
+		c->batch = q->batch;
+	c->latency_ns = (uint64_t)q->latency_ms * 1000000ULL;
+	c->skip = 0;
+}
+
+static void
+accept_client(struct nau7802_server *srv){
+	struct server_client *c;
+	int fd, i;
+	fd = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if(fd == -1)
+		return;
+	for(i=0; i<SERVER_MAX_CLIENTS; i++)
+		if(srv->client[i].fd < 0)
+			break;
+	if(i == SERVER_MAX_CLIENTS){
+		close(fd);
+		return;
+	}
+	c = &srv->client[i];
+	memset(c, 0, sizeof(*c) - sizeof(c->out));
+	c->fd = fd;
+	c->cursor = NAU7802_streamCursor(srv->st);
+	c->decimation = 1;
+	c->batch = STREAM_DEF_BATCH;
+	c->latency_ns = STREAM_DEF_LATENCY_MS * 1000000ULL;
+}
+
+static void *
+server_thread(void *arg){
+	struct nau7802_server *srv = arg;
+	struct pollfd pfd[SERVER_MAX_CLIENTS + 1];
+	int map[SERVER_MAX_CLIENTS + 1];
+	uint64_t now;
+	int i, n;
+
+	while(atomic_load(&srv->run)){
+		pfd[0].fd = srv->listen_fd;
+		pfd[0].events = POLLIN;
+		n = 1;
+		for(i=0; i<SERVER_MAX_CLIENTS; i++){
+			if(srv->client[i].fd < 0)
+				continue;
+			pfd[n].fd = srv->client[i].fd;
+			pfd[n].events = POLLIN;
+			if(srv->client[i].out_len)
+				pfd[n].events |= POLLOUT;
+			map[n++] = i;
+		}
+		if(poll(pfd, n, SERVER_TICK_MS) > 0){
+			if(pfd[0].revents & POLLIN)
+				accept_client(srv);
+			for(i=1; i<n; i++){
+				if(pfd[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+					close_client(&srv->client[map[i]]);
+				else if(pfd[i].revents & POLLIN)
+					read_client(&srv->client[map[i]]);
+			}
+		}
+		now = NAU7802_getTimestamp();
+		for(i=0; i<SERVER_MAX_CLIENTS; i++)
+			if(srv->client[i].fd >= 0)
+				service_client(srv, &srv->client[i], now);
+	}
+	return NULL;
+}
+
+/*
+ * Listen on path, e.g. SERVER_PATH, and stream the
+ * samples of st to every client that connects.  An old
+ * socket file at path is removed.
+ *
+ * Return 0 on success or -1 on failure.
+ */
+int
+NAU7802_serverStart(struct nau7802_server *srv, struct nau7802_stream *st,
+		const char *path){
+	struct sockaddr_un addr;
+	int i;
+	memset(srv, 0, sizeof(*srv));
+	if(strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	srv->st = st;
+	strcpy(srv->path, path);
+	for(i=0; i<SERVER_MAX_CLIENTS; i++)
+		srv->client[i].fd = -1;
+
+	srv->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(srv->listen_fd == -1)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if(bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+		listen(srv->listen_fd, SERVER_MAX_CLIENTS) == -1){
+		close(srv->listen_fd);
+		return -1;
+	}
+	atomic_init(&srv->run, 1);
+	if(pthread_create(&srv->thread, NULL, server_thread, srv) != 0){
+		close(srv->listen_fd);
+		unlink(path);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Stop serving, close all clients and remove
+ * the socket file.
+ */
+void
+NAU7802_serverStop(struct nau7802_server *srv){
+	int i;
+	if(!atomic_exchange(&srv->run, 0))
+		return;
+	pthread_join(srv->thread, NULL);
+	for(i=0; i<SERVER_MAX_CLIENTS; i++)
+		close_client(&srv->client[i]);
+	close(srv->listen_fd);
+	unlink(srv->path);
+}
+
+/*
+ * Count connected clients.
+ *
+ * Return the number of clients.
+ */
+int
+NAU7802_serverClients(struct nau7802_server *srv){
+	int i, n=0;
+	for(i=0; i<SERVER_MAX_CLIENTS; i++)
+		if(srv->client[i].fd >= 0)
+			n++;
+	return n;
+}
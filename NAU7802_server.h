@@ -0,0 +1,87 @@
+/*
+ * Header for the Unix domain socket server that streams the
+ * samples of one device to local subscribers, and for the
+ * frames clients receive.
+ *
+ * A client connects to the socket and may send one
+ * struct stream_subscribe to choose decimation and batching.
+ * It then receives frames of a struct stream_frame followed
+ * by count struct stream_record, in host byte order.
+ */
+
+#ifndef NAU7802_SERVER_H
+#define NAU7802_SERVER_H
+
+/* include headers */
+#include "NAU7802_stream.h"
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* define macros */
+#define SERVER_PATH "/tmp/nau7802.sock"	/* default socket path */
+#define SERVER_MAX_CLIENTS 16	/* subscribers per server */
+#define SERVER_TICK_MS 5	/* longest wait for new samples */
+#define STREAM_MAGIC 0x4E415553	/* "NAUS" */
+#define STREAM_MAX_BATCH 256	/* records per frame */
+#define STREAM_DEF_BATCH 32	/* records per frame unless subscribed */
+#define STREAM_DEF_LATENCY_MS 50	/* longest a record waits in a batch */
+
+/* optional request sent by a client after connecting */
+struct stream_subscribe{
+	uint32_t magic;		/* STREAM_MAGIC */
+	uint16_t decimation;	/* send every nth sample, 1 for all */
+	uint16_t batch;		/* records per frame, 1-STREAM_MAX_BATCH */
+	uint32_t latency_ms;	/* send a partial frame after this long */
+};
+
+struct stream_frame{
+	uint32_t magic;		/* STREAM_MAGIC */
+	uint16_t count;		/* records following */
+	uint16_t decimation;	/* decimation in use */
+	uint32_t lost;		/* samples this client lost so far */
+	uint32_t pad;
+};
+
+struct stream_record{
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of read */
+	uint32_t seq;		/* sample number since start */
+	int32_t raw;		/* raw ADC value */
+	double load;		/* linear load */
+};
+
+struct server_client{
+	int fd;			/* socket or -1 */
+	uint32_t cursor;	/* next stream sample */
+	uint32_t lost;		/* samples skipped because client was slow */
+	uint32_t decimation;	/* send every nth sample */
+	uint32_t skip;		/* samples until next one sent */
+	uint32_t batch;		/* records per frame */
+	uint64_t latency_ns;	/* longest wait of a partial frame */
+	uint64_t first_ns;	/* when the first pending record was taken */
+	int npend;		/* records pending */
+	size_t out_len;		/* bytes of frame in out */
+	size_t out_off;		/* bytes of frame already sent */
+	struct stream_subscribe req;	/* subscribe request being read */
+	size_t req_len;
+	unsigned char out[sizeof(struct stream_frame) +
+		STREAM_MAX_BATCH * sizeof(struct stream_record)];
+};
+
+struct nau7802_server{
+	int listen_fd;
+	char path[108];		/* socket path */
+	struct nau7802_stream *st;
+	struct server_client client[SERVER_MAX_CLIENTS];
+	atomic_int run;
+	pthread_t thread;
+};
+
+int NAU7802_serverStart(struct nau7802_server *srv, struct nau7802_stream *st,
+		const char *path);
+
+void NAU7802_serverStop(struct nau7802_server *srv);
+
+int NAU7802_serverClients(struct nau7802_server *srv);
+
+#endif
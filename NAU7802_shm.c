@@ -0,0 +1,155 @@
+/*
+ * Shared memory publisher with a seqlock per sensor.  The
+ * writer makes the sequence odd, writes the sample and makes
+ * it even again.  A reader copies the sample and retries if
+ * the sequence was odd or changed during the copy, so the
+ * writer never waits for readers and readers only spin for
+ * the few nanoseconds a write takes.
+ */
+
+/* include headers */
+#include "NAU7802_shm.h"
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Create or reuse the shared memory object name, e.g.
+ * SHM_NAME, for nsensors sensors and map it for writing.
+ * All samples start out without SHM_VALID.
+ *
+ * Return the region or NULL on failure.
+ */
+struct shm_region *
+NAU7802_shmCreate(const char *name, int nsensors){
+	struct shm_region *shm;
+	int fd, i;
+	if(nsensors < 1 || nsensors > SHM_MAX_SENSORS)
+		return NULL;
+	fd = shm_open(name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if(fd == -1)
+		return NULL;
+	if(ftruncate(fd, sizeof(struct shm_region)) == -1){
+		close(fd);
+		return NULL;
+	}
+	shm = mmap(NULL, sizeof(struct shm_region), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if(shm == MAP_FAILED)
+		return NULL;
+	for(i=0; i<SHM_MAX_SENSORS; i++){
+		atomic_store(&shm->sensor[i].seq, 0);
+		shm->sensor[i].status = 0;
+	}
+	shm->nsensors = nsensors;
+	shm->version = SHM_VERSION;
+	atomic_thread_fence(memory_order_release);
+	shm->magic = SHM_MAGIC;
+	return shm;
+}
+
+/*
+ * Map an existing region read only.
+ *
+ * Return the region or NULL if it does not exist
+ * or was not made by NAU7802_shmCreate.
+ */
+struct shm_region *
+NAU7802_shmOpen(const char *name){
+	struct shm_region *shm;
+	struct stat st;
+	int fd;
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd == -1)
+		return NULL;
+	if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(struct shm_region)){
+		close(fd);
+		return NULL;
+	}
+	shm = mmap(NULL, sizeof(struct shm_region), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(shm == MAP_FAILED)
+		return NULL;
+	if(shm->magic != SHM_MAGIC || shm->version != SHM_VERSION){
+		munmap(shm, sizeof(struct shm_region));
+		return NULL;
+	}
+	return shm;
+}
+
+/*
+ * Unmap a region.
+ */
+void
+NAU7802_shmClose(struct shm_region *shm){
+	munmap(shm, sizeof(struct shm_region));
+}
+
+/*
+ * Remove the shared memory object.  Mapped
+ * regions stay valid until closed.
+ *
+ * Return 0 on success or -1 on failure.
+ */
+int
+NAU7802_shmUnlink(const char *name){
+	return shm_unlink(name);
+}
+
+/*
+ * Publish the latest sample of a sensor.  Only one
+ * thread may publish a given sensor.
+ */
+void
+NAU7802_shmPublish(struct shm_region *shm, int sensor, int32_t raw,
+		double load, double filtered, uint64_t t_ns, uint32_t status){
+	struct shm_value *v;
+	unsigned int seq;
+	if(sensor < 0 || sensor >= (int)shm->nsensors)
+		return;
+	v = &shm->sensor[sensor];
+	seq = atomic_load_explicit(&v->seq, memory_order_relaxed);
+	atomic_store_explicit(&v->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	v->raw = raw;
+	v->load = load;
+	v->filtered = filtered;
+	v->t_ns = t_ns;
+	v->status = status | SHM_VALID;
+	atomic_store_explicit(&v->seq, seq + 2, memory_order_release);
+}
+
+/*
+ * Read the latest sample of a sensor.  Makes no system
+ * calls and never blocks the writer.
+ *
+ * Return 1 if a valid sample was copied to s, 0 if
+ * nothing was published yet or -1 on invalid sensor.
+ */
+int
+NAU7802_shmRead(struct shm_region *shm, int sensor, struct shm_sample *s){
+	struct shm_value *v;
+	unsigned int s1, s2;
+	if(sensor < 0 || sensor >= (int)shm->nsensors)
+		return -1;
+	v = &shm->sensor[sensor];
+	do{
+		s1 = atomic_load_explicit(&v->seq, memory_order_acquire);
+		if(s1 & 1)
+			continue;
+		s->raw = v->raw;
+		s->load = v->load;
+		s->filtered = v->filtered;
+		s->t_ns = v->t_ns;
+		s->status = v->status;
+		atomic_thread_fence(memory_order_acquire);
+		s2 = atomic_load_explicit(&v->seq, memory_order_relaxed);
+		if(s1 == s2)
+			break;
+	}while(1);
+	s->seq = s1;
+	return (s->status & SHM_VALID) ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Header for publishing the latest sample of each sensor in
+ * POSIX shared memory.  One process writes, any number of
+ * processes read without system calls or locks.
+ *
+ * Link with -lrt on older glibc.
+ */
+
+#ifndef NAU7802_SHM_H
+#define NAU7802_SHM_H
+
+/* include headers */
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* define macros */
+#define SHM_NAME "/nau7802"	/* default shared memory object */
+#define SHM_MAX_SENSORS 16	/* sensors per region */
+#define SHM_MAGIC 0x4E415537	/* "NAU7" */
+#define SHM_VERSION 1
+
+/* status bits */
+#define SHM_VALID 0x01		/* a sample has been published */
+#define SHM_ERROR 0x02		/* the last read failed */
+
+/* one sensor, on its own cache line so writers of
+ * different sensors do not slow each other's readers */
+struct shm_value{
+	atomic_uint seq;	/* odd while being written */
+	uint32_t status;	/* SHM_ bits */
+	int32_t raw;		/* raw ADC value */
+	int32_t pad;
+	double load;		/* linear load */
+	double filtered;	/* filtered load, same unit as load */
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of sample */
+} __attribute__((aligned(64)));
+
+struct shm_region{
+	uint32_t magic;		/* SHM_MAGIC */
+	uint32_t version;	/* SHM_VERSION */
+	uint32_t nsensors;	/* sensors in use */
+	struct shm_value sensor[SHM_MAX_SENSORS];
+};
+
+/* copy of one sensor for readers */
+struct shm_sample{
+	uint32_t seq;		/* changes on every publish */
+	uint32_t status;
+	int32_t raw;
+	double load;
+	double filtered;
+	uint64_t t_ns;
+};
+
+struct shm_region *NAU7802_shmCreate(const char *name, int nsensors);
+
+struct shm_region *NAU7802_shmOpen(const char *name);
+
+void NAU7802_shmClose(struct shm_region *shm);
+
+int NAU7802_shmUnlink(const char *name);
+
+void NAU7802_shmPublish(struct shm_region *shm, int sensor, int32_t raw,
+		double load, double filtered, uint64_t t_ns, uint32_t status);
+
+int NAU7802_shmRead(struct shm_region *shm, int sensor, struct shm_sample *s);
+
+#endif
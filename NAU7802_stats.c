@@ -0,0 +1,139 @@
+/*
+ * Text output of the I2C and sample counters.  The dump thread
+ * only copies counters and never touches the bus, so it can
+ * stay on while sampling at 320 SPS.  Each line is appended
+ * with the file opened only for the dump, so it can be
+ * rotated or truncated at any time.
+ */
+
+/* include headers */
+#include "NAU7802_stats.h"
+#include <string.h>
+#include <time.h>
+
+/*
+ * Write one line with the counters of a device:
+ * time, name, reads, writes, bytes, errors, CR polls,
+ * samples, missed, polls per sample, calibrations,
+ * ms spent calibrating, retries and timeouts.
+ *
+ * Return 1 if a line was written or 0 if the device
+ * had no I2C traffic.
+ */
+int
+NAU7802_printStats(FILE *fp, const char *name, const struct nau7802_stats *stats){
+	struct nau7802_stats st;
+	NAU7802_getStats(stats, &st);
+	if(st.reads + st.writes == 0)
+		return 0;
+	fprintf(fp, "%llu %s reads %llu writes %llu bytes %llu errors %llu "
+			"polls %llu samples %llu missed %llu polls/sample %.2f "
+			"cals %llu cal_ms %.1f retries %llu timeouts %llu\n",
+			(unsigned long long)NAU7802_getTimestamp(), name,
+			(unsigned long long)st.reads, (unsigned long long)st.writes,
+			(unsigned long long)st.bytes, (unsigned long long)st.errors,
+			(unsigned long long)st.cr_polls, (unsigned long long)st.samples,
+			(unsigned long long)st.missed,
+			st.samples ? (double)st.cr_polls / st.samples : 0.0,
+			(unsigned long long)st.cals, st.cal_ns / 1e6,
+			(unsigned long long)st.retries, (unsigned long long)st.timeouts);
+	return 1;
+}
+
+static void *
+dump_thread(void *arg){
+	struct stats_dump *sd = arg;
+	struct timespec ts;
+	uint64_t next;
+	FILE *fp;
+	int i;
+
+	next = NAU7802_getTimestamp();
+	pthread_mutex_lock(&sd->lock);
+	while(sd->run){
+		next += sd->interval_ns;
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		while(sd->run && pthread_cond_timedwait(&sd->cond, &sd->lock, &ts) == 0);
+		if(!sd->run)
+			break;
+		fp = fopen(sd->path, "a");
+		if(fp != NULL){
+			for(i=0; i<sd->ndevs; i++)
+				NAU7802_printStats(fp, sd->name[i], sd->stats[i]);
+			fclose(fp);
+		}
+	}
+	pthread_mutex_unlock(&sd->lock);
+	return NULL;
+}
+
+/*
+ * Append the counters of the devices added with
+ * NAU7802_statsDumpAdd to path every interval_ms
+ * from a thread.
+ *
+ * Return 0 on success or -1 on failure.
+ */
+int
+NAU7802_statsDumpStart(struct stats_dump *sd, const char *path, int interval_ms){
+	pthread_condattr_t attr;
+	memset(sd, 0, sizeof(*sd));
+	if(strlen(path) >= STATS_PATH_LEN || interval_ms <= 0)
+		return -1;
+	strcpy(sd->path, path);
+	sd->interval_ns = (uint64_t)interval_ms * 1000000ULL;
+	sd->run = 1;
+	pthread_mutex_init(&sd->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sd->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	if(pthread_create(&sd->thread, NULL, dump_thread, sd) != 0){
+		sd->run = 0;
+		pthread_cond_destroy(&sd->cond);
+		pthread_mutex_destroy(&sd->lock);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Add the counters of a device, usually
+ * &dev->stats, to the dump under name.  The
+ * counters must stay valid until the dump stops.
+ *
+ * Return 0 on success or -1 if the dump is full.
+ */
+int
+NAU7802_statsDumpAdd(struct stats_dump *sd, const char *name,
+		const struct nau7802_stats *stats){
+	int z = -1;
+	pthread_mutex_lock(&sd->lock);
+	if(sd->ndevs < STATS_MAX_DEVS){
+		snprintf(sd->name[sd->ndevs], STATS_NAME_LEN, "%s", name);
+		sd->stats[sd->ndevs] = stats;
+		sd->ndevs++;
+		z = 0;
+	}
+	pthread_mutex_unlock(&sd->lock);
+	return z;
+}
+
+/*
+ * Stop the dump thread.
+ */
+void
+NAU7802_statsDumpStop(struct stats_dump *sd){
+	pthread_mutex_lock(&sd->lock);
+	if(!sd->run){
+		pthread_mutex_unlock(&sd->lock);
+		return;
+	}
+	sd->run = 0;
+	pthread_cond_signal(&sd->cond);
+	pthread_mutex_unlock(&sd->lock);
+	pthread_join(sd->thread, NULL);
+	pthread_cond_destroy(&sd->cond);
+	pthread_mutex_destroy(&sd->lock);
+}
@@ -0,0 +1,40 @@
+/*
+ * Header for writing the counters of NAU7802_getStats as
+ * text, once or periodically from a thread.
+ */
+
+#ifndef NAU7802_STATS_H
+#define NAU7802_STATS_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdio.h>
+#include <pthread.h>
+
+/* define macros */
+#define STATS_PATH_LEN 256	/* length of dump file name */
+#define STATS_NAME_LEN 32	/* length of a device name */
+#define STATS_MAX_DEVS 16	/* devices per dump */
+
+struct stats_dump{
+	char path[STATS_PATH_LEN];	/* file the lines are appended to */
+	uint64_t interval_ns;	/* time between dumps */
+	char name[STATS_MAX_DEVS][STATS_NAME_LEN];	/* device names */
+	const struct nau7802_stats *stats[STATS_MAX_DEVS];	/* device counters */
+	int ndevs;
+	int run;		/* dump thread running */
+	pthread_mutex_t lock;	/* protects run and the devices */
+	pthread_cond_t cond;	/* signalled to stop */
+	pthread_t thread;
+};
+
+int NAU7802_printStats(FILE *fp, const char *name, const struct nau7802_stats *stats);
+
+int NAU7802_statsDumpStart(struct stats_dump *sd, const char *path, int interval_ms);
+
+int NAU7802_statsDumpAdd(struct stats_dump *sd, const char *name,
+		const struct nau7802_stats *stats);
+
+void NAU7802_statsDumpStop(struct stats_dump *sd);
+
+#endif
@@ -0,0 +1,381 @@
+/*
+ * Sample stream.  The acquisition thread is the only writer
+ * of the ring.  Consumers copy samples out and check that the
+ * writer did not reuse a slot during the copy; a consumer that
+ * falls more than STREAM_RING_LEN samples behind skips ahead
+ * and is told how many samples it lost.
+ *
+ * The eventfd is only written when the drainer has caught up
+ * and asked to be woken, so a consumer that drains in batches
+ * costs one write per batch, not one per sample.
+ *
+ * Latency costs the thread two clock reads and two histogram
+ * records per sample, far below the I2C read.  The consumer
+ * stages are recorded by each consumer in its own struct
+ * stream_lat with one clock read per batch.
+ *
+ * Once the drift fit has a full window its period replaces
+ * the CRS period in the conversion numbering, so long gaps
+ * are counted with the real rate.
+ *
+ * The thread waits in NAU7802_schedWait without the device
+ * lock, since CR polls change nothing on the chip, and only
+ * takes the lock to read, so N streams do not keep N cores
+ * busy.  opts.spin polls CR under the lock and yields between
+ * polls instead; a SCHED_FIFO thread should not spin, it
+ * only yields to threads of its own priority.  Nothing on the
+ * loop allocates or prints.
+ *
+ * A failed read, or no conversion for STREAM_STALL_PERIODS,
+ * makes the thread call NAU7802_devRecover, at most once per
+ * stall interval.  Conversions lost meanwhile show up as a
+ * gap in the numbering of the next sample.
+ */
+
+/* pthread_attr_setaffinity_np */
+#define _GNU_SOURCE
+
+/* include headers */
+#include "NAU7802_stream.h"
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+#define STREAM_MASK (STREAM_RING_LEN - 1)
+
+static void
+stream_wake(struct nau7802_stream *st){
+	uint64_t one=1;
+	if(write(st->efd, &one, sizeof(one)) != sizeof(one))
+		atomic_store(&st->wake, 1);	/* counter full, retry next sample */
+}
+
+/*
+ * Touch the stack the loop will use so it takes
+ * no page faults, locked in memory with mlockall.
+ */
+static void
+stream_prefault(void){
+	volatile unsigned char buf[STREAM_PREFAULT_LEN];
+	size_t i;
+	for(i=0; i<sizeof(buf); i+=4096)
+		buf[i] = 0;
+}
+
+static void *
+stream_thread(void *arg){
+	struct nau7802_stream *st = arg;
+	struct nau7802_dev *dev = st->dev;
+	struct stream_sample *s;
+	unsigned int h;
+	uint64_t t_cr, last;
+	int32_t raw;
+	int fd, ready;
+
+	if(st->opts.prefault)
+		stream_prefault();
+	/* polls without the lock count into the device too */
+	NAU7802_bindStats(&dev->stats);
+	/* NAU7802_devRecover keeps the fd number, so the
+	   copy stays good for polls without the lock */
+	NAU7802_devLock(dev);
+	fd = dev->fd;
+	NAU7802_devUnlock(dev);
+	NAU7802_schedInit(&st->se, dev->rate, NAU7802_getTimestamp());
+	last = NAU7802_getTimestamp();
+	while(atomic_load_explicit(&st->run, memory_order_relaxed)){
+		if(!st->opts.spin){
+			ready = NAU7802_schedWait(&st->se, fd);
+			/* when CR was seen, not when the lock was got */
+			t_cr = st->se.read_ns;
+			NAU7802_devLock(dev);
+		}
+		else{
+			NAU7802_devLock(dev);
+			ready = NAU7802_pollCR(fd);
+			t_cr = NAU7802_getTimestamp();
+		}
+		if(ready == 1 && NAU7802_readRaw(fd, &raw) == -1)
+			ready = -1;
+		if(ready == 1){
+			h = atomic_load_explicit(&st->head, memory_order_relaxed);
+			s = &st->ring[h & STREAM_MASK];
+			s->raw = raw;
+			s->t_ns = NAU7802_getTimestamp();
+			s->seq = h;
+			s->status = NAU7802_seqUpdate(&st->seq, t_cr, s->t_ns, &s->conv);
+			if(s->status & SAMPLE_DUP)
+				s->t_conv_ns = NAU7802_driftTime(&st->drift, s->conv);
+			else
+				s->t_conv_ns = NAU7802_driftUpdate(&st->drift, s->conv, t_cr);
+			if(st->drift.n >= DRIFT_WINDOW)
+				st->seq.period_ns = (uint64_t)st->drift.period_ns;
+			s->load = NAU7802_getLoadFromADC(&dev->lc, s->raw);
+			s->t_cr_ns = t_cr;
+			s->t_out_ns = NAU7802_getTimestamp();
+			NAU7802_histRecord(&st->lat[STREAM_LAT_READ], s->t_ns - t_cr);
+			NAU7802_histRecord(&st->lat[STREAM_LAT_FILTER], s->t_out_ns - s->t_ns);
+			dev->raw = s->raw;
+			dev->load = s->load;
+			dev->t_ns = s->t_ns;
+			atomic_store_explicit(&st->head, h + 1, memory_order_release);
+			last = t_cr;
+		}
+		else if(NAU7802_getTimestamp() - last >=
+				STREAM_STALL_PERIODS * st->seq.period_ns){
+			NAU7802_devRecover(dev);
+			fd = dev->fd;
+			last = NAU7802_getTimestamp();
+			NAU7802_schedInit(&st->se, dev->rate, last);
+		}
+		NAU7802_devUnlock(dev);
+		if(ready == 1 && atomic_exchange(&st->wake, 0))
+			stream_wake(st);
+		if(ready != 1 && st->opts.spin)
+			sched_yield();
+	}
+	return NULL;
+}
+
+/*
+ * Start the acquisition thread on a configured
+ * device.  The device must stay open until
+ * NAU7802_streamStop.  Conversions are numbered
+ * with the rate it is configured with now.
+ *
+ * Return 0 on success or -1 on failure.
+ */
+int
+NAU7802_streamStart(struct nau7802_stream *st, struct nau7802_dev *dev){
+	return NAU7802_streamStartOpts(st, dev, NULL);
+}
+
+/*
+ * Start the acquisition thread like
+ * NAU7802_streamStart with the options of opts,
+ * or the default thread if opts is NULL.  SCHED_FIFO
+ * and mlock need CAP_SYS_NICE and CAP_IPC_LOCK or
+ * enough RLIMIT_RTPRIO and RLIMIT_MEMLOCK.
+ *
+ * Return 0 on success or -1 on failure, with errno
+ * set when an option was refused.
+ */
+int
+NAU7802_streamStartOpts(struct nau7802_stream *st, struct nau7802_dev *dev,
+		const struct stream_opts *opts){
+	struct sched_param sp;
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	int z;
+
+	memset(st, 0, sizeof(*st));
+	st->dev = dev;
+	if(opts)
+		st->opts = *opts;
+	atomic_init(&st->head, 0);
+	atomic_init(&st->run, 1);
+	atomic_init(&st->wake, 1);
+	NAU7802_histInit(&st->lat[STREAM_LAT_READ]);
+	NAU7802_histInit(&st->lat[STREAM_LAT_FILTER]);
+	NAU7802_seqInit(&st->seq, dev->rate);
+	NAU7802_driftInit(&st->drift, dev->rate);
+	if(st->opts.mlock && mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+		return -1;
+	st->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(st->efd == -1)
+		return -1;
+
+	pthread_attr_init(&attr);
+	if(st->opts.prefault)
+		pthread_attr_setstacksize(&attr, STREAM_STACK_LEN);
+	if(st->opts.prio > 0){
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		sp.sched_priority = st->opts.prio;
+		pthread_attr_setschedparam(&attr, &sp);
+	}
+	if(st->opts.cpu > 0){
+		CPU_ZERO(&cpus);
+		CPU_SET(st->opts.cpu - 1, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+	z = pthread_create(&st->thread, &attr, stream_thread, st);
+	pthread_attr_destroy(&attr);
+	if(z != 0){
+		atomic_store(&st->run, 0);
+		close(st->efd);
+		st->efd = -1;
+		errno = z;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Stop the acquisition thread and close the
+ * eventfd.  Samples in the ring can still be read.
+ */
+void
+NAU7802_streamStop(struct nau7802_stream *st){
+	if(!atomic_exchange(&st->run, 0))
+		return;
+	pthread_join(st->thread, NULL);
+	close(st->efd);
+	st->efd = -1;
+}
+
+/*
+ * Get a cursor that starts at the next sample.
+ *
+ * Return the cursor.
+ */
+uint32_t
+NAU7802_streamCursor(struct nau7802_stream *st){
+	return atomic_load_explicit(&st->head, memory_order_acquire);
+}
+
+/*
+ * Copy up to max samples after cursor to out without
+ * waiting, and advance cursor.  If lost is not NULL the
+ * number of samples that were overwritten before they
+ * could be read is added to it.
+ *
+ * Return the number of samples copied.
+ */
+int
+NAU7802_streamRead(struct nau7802_stream *st, uint32_t *cursor,
+		struct stream_sample *out, int max, uint32_t *lost){
+	unsigned int h;
+	uint32_t c = *cursor, skipped=0;
+	int n=0;
+
+	while(n < max){
+		h = atomic_load_explicit(&st->head, memory_order_acquire);
+		if(c == h)
+			break;
+		if(h - c > STREAM_RING_LEN){
+			skipped += h - c - STREAM_RING_LEN;
+			c = h - STREAM_RING_LEN;
+		}
+		out[n] = st->ring[c & STREAM_MASK];
+		atomic_thread_fence(memory_order_acquire);
+		h = atomic_load_explicit(&st->head, memory_order_relaxed);
+		/* the writer may have reused the slot during the copy */
+		if(h - c >= STREAM_RING_LEN){
+			skipped++;
+			c++;
+			continue;
+		}
+		c++;
+		n++;
+	}
+	*cursor = c;
+	if(lost)
+		*lost += skipped;
+	return n;
+}
+
+/*
+ * Get an fd for poll, select or epoll that is
+ * readable when there are samples to drain.  Meant
+ * for one event loop per stream; other consumers
+ * use NAU7802_streamRead.
+ *
+ * Return the fd.
+ */
+int
+NAU7802_streamFd(struct nau7802_stream *st){
+	return st->efd;
+}
+
+/*
+ * Read samples like NAU7802_streamRead without waiting,
+ * and rearm the fd once caught up.  Call when the fd is
+ * readable, until it returns less than max.
+ *
+ * Return the number of samples copied.
+ */
+int
+NAU7802_streamDrain(struct nau7802_stream *st, uint32_t *cursor,
+		struct stream_sample *out, int max, uint32_t *lost){
+	uint64_t count;
+	int n;
+	/* clear the fd, samples may wait even if it was not set */
+	if(read(st->efd, &count, sizeof(count)) != sizeof(count))
+		count = 0;
+	n = NAU7802_streamRead(st, cursor, out, max, lost);
+	if(n < max){
+		atomic_store(&st->wake, 1);
+		/* a sample written before wake was set gets no write */
+		if(*cursor != atomic_load_explicit(&st->head, memory_order_acquire) &&
+			atomic_exchange(&st->wake, 0))
+			stream_wake(st);
+	}
+	return n;
+}
+
+/*
+ * Clear all stages of a consumer's latencies.
+ */
+void
+NAU7802_streamLatInit(struct stream_lat *lat){
+	int i;
+	for(i=0; i<STREAM_LAT_STAGES; i++)
+		NAU7802_histInit(&lat->stage[i]);
+}
+
+/*
+ * Record the POP and TOTAL stages of n samples
+ * just read, e.g. right after NAU7802_streamRead.
+ */
+void
+NAU7802_streamLatPop(struct stream_lat *lat, const struct stream_sample *s, int n){
+	uint64_t now;
+	int i;
+	if(n <= 0)
+		return;
+	now = NAU7802_getTimestamp();
+	for(i=0; i<n; i++){
+		NAU7802_histRecord(&lat->stage[STREAM_LAT_POP], now - s[i].t_out_ns);
+		NAU7802_histRecord(&lat->stage[STREAM_LAT_TOTAL], now - s[i].t_cr_ns);
+	}
+}
+
+/*
+ * Copy the READ and FILTER stages of the thread
+ * into lat.  They are recorded under the device
+ * lock, so the copy is consistent.
+ */
+void
+NAU7802_streamLatGet(struct nau7802_stream *st, struct stream_lat *lat){
+	NAU7802_devLock(st->dev);
+	lat->stage[STREAM_LAT_READ] = st->lat[STREAM_LAT_READ];
+	lat->stage[STREAM_LAT_FILTER] = st->lat[STREAM_LAT_FILTER];
+	NAU7802_devUnlock(st->dev);
+}
+
+/*
+ * Copy the conversion numbering of the thread
+ * to sq, for its gap, duplicate and overrun
+ * counts.
+ */
+void
+NAU7802_streamSeqGet(struct nau7802_stream *st, struct seq_track *sq){
+	NAU7802_devLock(st->dev);
+	*sq = st->seq;
+	NAU7802_devUnlock(st->dev);
+}
+
+/*
+ * Copy the conversion clock fit of the thread to
+ * dr, for the measured rate and its ppm error.
+ */
+void
+NAU7802_streamDriftGet(struct nau7802_stream *st, struct drift_est *dr){
+	NAU7802_devLock(st->dev);
+	*dr = st->drift;
+	NAU7802_devUnlock(st->dev);
+}
@@ -0,0 +1,110 @@
+/*
+ * Header for the sample stream.  An acquisition thread reads
+ * one device and writes every sample to a ring; any number of
+ * consumers read the ring with their own cursor and can never
+ * slow down acquisition.  An event loop can wait on the fd
+ * from NAU7802_streamFd and empty it with NAU7802_streamDrain.
+ * Every sample carries the time its conversion was seen ready,
+ * read and converted, and the stages are kept as latency
+ * histograms.  Samples are also numbered by conversion so lost
+ * and repeated conversions show in their status, and timed by
+ * a fit of the conversion clock that removes the poll jitter.
+ * The acquisition thread sleeps until each conversion;
+ * NAU7802_streamStartOpts can run it as a real-time thread.
+ */
+
+#ifndef NAU7802_STREAM_H
+#define NAU7802_STREAM_H
+
+/* include headers */
+#include "NAU7802_dev.h"
+#include "NAU7802_hist.h"
+#include "NAU7802_seq.h"
+#include "NAU7802_drift.h"
+#include "NAU7802_sched.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* define macros */
+#define STREAM_RING_LEN 4096	/* samples kept, power of 2, 12.8 s at 320 SPS */
+#define STREAM_STACK_LEN (256 * 1024)	/* thread stack with prefault */
+#define STREAM_PREFAULT_LEN (64 * 1024)	/* stack touched before the loop */
+#define STREAM_STALL_PERIODS 8	/* conversions missing before a recovery */
+
+/* latency stages of struct stream_lat */
+#define STREAM_LAT_READ 0	/* CR seen to data read */
+#define STREAM_LAT_FILTER 1	/* data read to load out */
+#define STREAM_LAT_POP 2	/* load out to consumer */
+#define STREAM_LAT_TOTAL 3	/* CR seen to consumer */
+#define STREAM_LAT_STAGES 4
+
+struct stream_sample{
+	uint32_t seq;		/* sample number since start */
+	uint32_t status;	/* SAMPLE_ status bits, 0 when good */
+	int32_t raw;		/* raw ADC value */
+	uint32_t conv;		/* conversion number since start */
+	double load;		/* linear load */
+	uint64_t t_ns;		/* CLOCK_MONOTONIC time of read */
+	uint64_t t_cr_ns;	/* time CR was seen */
+	uint64_t t_out_ns;	/* time load was ready */
+	uint64_t t_conv_ns;	/* fitted time of the conversion */
+};
+
+struct stream_lat{
+	struct lat_hist stage[STREAM_LAT_STAGES];
+};
+
+/* acquisition thread options, all 0 is the default thread */
+struct stream_opts{
+	int prio;		/* SCHED_FIFO priority 1-99, 0 for the default policy */
+	int cpu;		/* CPU to run on plus 1, 0 for any */
+	int mlock;		/* 1 to lock all memory of the process */
+	int prefault;		/* 1 to prefault STREAM_PREFAULT_LEN of stack */
+	int spin;		/* 1 to spin on CR, 0 to sleep until ready */
+};
+
+struct nau7802_stream{
+	struct nau7802_dev *dev;	/* device read by the thread */
+	struct stream_sample ring[STREAM_RING_LEN];
+	atomic_uint head;	/* samples written */
+	atomic_int run;		/* acquisition thread running */
+	int efd;		/* eventfd, readable when samples wait */
+	atomic_int wake;	/* 1 when the drainer needs an eventfd write */
+	struct lat_hist lat[2];	/* READ and FILTER stages, written by the thread */
+	struct seq_track seq;	/* conversion numbering, written by the thread */
+	struct drift_est drift;	/* conversion clock fit, written by the thread */
+	struct stream_opts opts;	/* thread options */
+	struct sched_entry se;	/* ready prediction unless opts.spin */
+	pthread_t thread;
+};
+
+int NAU7802_streamStart(struct nau7802_stream *st, struct nau7802_dev *dev);
+
+int NAU7802_streamStartOpts(struct nau7802_stream *st, struct nau7802_dev *dev,
+		const struct stream_opts *opts);
+
+void NAU7802_streamStop(struct nau7802_stream *st);
+
+uint32_t NAU7802_streamCursor(struct nau7802_stream *st);
+
+int NAU7802_streamRead(struct nau7802_stream *st, uint32_t *cursor,
+		struct stream_sample *out, int max, uint32_t *lost);
+
+int NAU7802_streamFd(struct nau7802_stream *st);
+
+int NAU7802_streamDrain(struct nau7802_stream *st, uint32_t *cursor,
+		struct stream_sample *out, int max, uint32_t *lost);
+
+void NAU7802_streamLatInit(struct stream_lat *lat);
+
+void NAU7802_streamLatPop(struct stream_lat *lat, const struct stream_sample *s, int n);
+
+void NAU7802_streamLatGet(struct nau7802_stream *st, struct stream_lat *lat);
+
+void NAU7802_streamSeqGet(struct nau7802_stream *st, struct seq_track *sq);
+
+void NAU7802_streamDriftGet(struct nau7802_stream *st, struct drift_est *dr);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * Temperature compensation.  A temperature read switches the
+ * PGA to gain 1 and its input to the temperature sensor, lets
+ * TEMP_DISCARD conversions settle, takes one conversion and
+ * switches back, discarding again.  So every temperature read
+ * costs 2 * discard + 1 load conversions, which are counted
+ * in lost.
+ *
+ * The model is linear around the temperature of the first
+ * read, temp_ref:
+ *	raw = zero_ref + off_slope dt + span (1 + gain_slope dt)
+ * where dt = temp - temp_ref.  Zero points taken at no load
+ * give off_slope and zero_ref, span points with a constant
+ * load give gain_slope.
+ */
+
+/* include headers */
+#include "NAU7802_temp.h"
+#include <string.h>
+#include <math.h>
+
+static void
+fit_add(struct temp_fit *f, double x, double y){
+	f->n++;
+	f->sx += x;
+	f->sy += y;
+	f->sxx += x * x;
+	f->sxy += x * y;
+}
+
+/*
+ * Least squares line y = a + b x.
+ *
+ * Return 0 or -1 if there is no spread in x.
+ */
+static int
+fit_line(struct temp_fit *f, double *a, double *b){
+	double d;
+	if(f->n < 2)
+		return -1;
+	d = f->n * f->sxx - f->sx * f->sx;
+	if(fabs(d) < 1e-9)
+		return -1;
+	*b = (f->n * f->sxy - f->sx * f->sy) / d;
+	*a = (f->sy - *b * f->sx) / f->n;
+	return 0;
+}
+
+/*
+ * Initialize with a temperature read every
+ * interval_ms.  gain is the PGA gain used for
+ * loads, restored after each temperature read.
+ */
+void
+NAU7802_initTempComp(struct temp_comp *tc, int interval_ms, int gain){
+	memset(tc, 0, sizeof(*tc));
+	tc->state = TEMP_LOAD;
+	tc->discard = TEMP_DISCARD;
+	tc->gain = gain;
+	tc->interval_ns = (uint64_t)interval_ms * 1000000ULL;
+	tc->next_ns = NAU7802_getTimestamp();
+}
+
+/*
+ * Read the conversion that is ready, call after
+ * NAU7802_CR returns 1.  Load conversions are
+ * compensated and converted with lc; when a
+ * temperature read is due the input is switched
+ * and the following conversions are used for it.
+ *
+ * Return 1 if *load was set or 0 if the conversion
+ * was used for temperature.
+ */
+int
+NAU7802_getTempCompLoad(int fd, struct temp_comp *tc, struct load_cal *lc,
+		double *load){
+	int32_t raw;
+	uint64_t now;
+
+	raw = NAU7802_readADC(fd);
+	now = NAU7802_getTimestamp();
+	if(tc->state == TEMP_LOAD){
+		tc->raw = raw;
+		*load = NAU7802_getLoadFromADC(lc, NAU7802_tempCompRaw(tc, raw));
+		if(now >= tc->next_ns){
+			NAU7802_setGain(fd, 1);
+			NAU7802_selectTempSensor(fd, 1);
+			tc->state = TEMP_SETTLE;
+			tc->skip = tc->discard;
+		}
+		return 1;
+	}
+
+	tc->lost++;
+	if(tc->skip > 0){
+		tc->skip--;
+		if(tc->skip == 0 && tc->state == TEMP_LOAD_SETTLE)
+			tc->state = TEMP_LOAD;
+		return 0;
+	}
+	/* settled conversion of the temperature sensor */
+	if(!tc->have_temp){
+		tc->temp = tc->temp_ref = raw;
+		tc->have_temp = 1;
+	}
+	else
+		tc->temp += TEMP_BETA * (raw - tc->temp);
+	tc->temp_reads++;
+	NAU7802_selectTempSensor(fd, 0);
+	NAU7802_setGain(fd, tc->gain);
+	tc->next_ns = now + tc->interval_ns;
+	tc->skip = tc->discard;
+	tc->state = tc->discard ? TEMP_LOAD_SETTLE : TEMP_LOAD;
+	return 0;
+}
+
+/*
+ * Remove the modelled temperature drift from
+ * a raw load value.
+ *
+ * Return the raw value at temp_ref.
+ */
+int32_t
+NAU7802_tempCompRaw(struct temp_comp *tc, int32_t raw){
+	double dt, span;
+	if(!tc->have_temp)
+		return raw;
+	dt = tc->temp - tc->temp_ref;
+	span = (raw - tc->zero_ref - tc->off_slope * dt) / (1.0 + tc->gain_slope * dt);
+	return (int32_t)lrint(span + tc->zero_ref);
+}
+
+/*
+ * Add the raw value read with no load at the
+ * current temperature, e.g. an average of the
+ * samples since the last temperature read, and
+ * refit off_slope and zero_ref.
+ *
+ * Return the number of zero points or -1 before
+ * the first temperature read.
+ */
+int
+NAU7802_tempAddZeroPoint(struct temp_comp *tc, int32_t raw){
+	double a, b;
+	if(!tc->have_temp)
+		return -1;
+	fit_add(&tc->off_fit, tc->temp, raw);
+	if(tc->off_fit.n == 1)
+		tc->zero_ref = raw;
+	else if(fit_line(&tc->off_fit, &a, &b) == 0){
+		tc->off_slope = b;
+		tc->zero_ref = a + b * tc->temp_ref;
+	}
+	return tc->off_fit.n;
+}
+
+/*
+ * Add raw values read with no load and with a
+ * constant load at the current temperature and
+ * refit gain_slope.
+ *
+ * Return the number of span points or -1 before
+ * the first temperature read.
+ */
+int
+NAU7802_tempAddSpanPoint(struct temp_comp *tc, int32_t raw_zero, int32_t raw_span){
+	double a, b, ref;
+	if(!tc->have_temp)
+		return -1;
+	fit_add(&tc->span_fit, tc->temp, (double)raw_span - raw_zero);
+	if(fit_line(&tc->span_fit, &a, &b) == 0){
+		ref = a + b * tc->temp_ref;
+		if(fabs(ref) > 0.0)
+			tc->gain_slope = b / ref;
+	}
+	return tc->span_fit.n;
+}
+
+/*
+ * Get the load conversions lost per temperature
+ * read so far.
+ *
+ * Return lost / temp_reads or 0 before the first.
+ */
+double
+NAU7802_tempLostPerRead(struct temp_comp *tc){
+	if(tc->temp_reads == 0)
+		return 0.0;
+	return (double)tc->lost / tc->temp_reads;
+}
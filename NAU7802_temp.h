@@ -0,0 +1,74 @@
+/*
+ * Header for temperature compensated loads.  Every interval
+ * the ADC input is switched to the on-chip temperature sensor
+ * for one conversion and back, and each load sample is
+ * corrected with a linear model of offset and gain against
+ * temperature.  Temperatures are kept in raw ADC counts at
+ * gain 1, since the model only needs a value that follows the
+ * chip temperature.
+ */
+
+#ifndef NAU7802_TEMP_H
+#define NAU7802_TEMP_H
+
+/* include headers */
+#include "NAU7802.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* define macros */
+#define TEMP_DISCARD 2		/* conversions discarded after each input switch */
+#define TEMP_BETA 0.25		/* smoothing of temperature readings */
+
+/* states of struct temp_comp */
+#define TEMP_LOAD 0		/* reading loads */
+#define TEMP_SETTLE 1		/* discarding after switch to temperature */
+#define TEMP_LOAD_SETTLE 2	/* discarding after switch back to load */
+
+/* running sums for a straight line fit */
+struct temp_fit{
+	int n;
+	double sx, sy, sxx, sxy;
+};
+
+struct temp_comp{
+	int state;		/* TEMP_ state */
+	int skip;		/* conversions left to discard */
+	int discard;		/* conversions discarded after a switch */
+	int gain;		/* PGA gain restored after a temperature read */
+	uint64_t interval_ns;	/* time between temperature reads */
+	uint64_t next_ns;	/* time of next temperature read */
+	double temp;		/* smoothed temperature in counts */
+	double temp_ref;	/* temperature the calibration was made at */
+	double zero_ref;	/* raw value at no load and temp_ref */
+	int have_temp;		/* 1 after the first temperature read */
+	double off_slope;	/* raw offset counts per temperature count */
+	double gain_slope;	/* relative gain change per temperature count */
+	struct temp_fit off_fit;	/* zero load raw against temperature */
+	struct temp_fit span_fit;	/* span raw against temperature */
+	int32_t raw;		/* last load conversion before compensation */
+	uint32_t temp_reads;	/* temperature reads done */
+	uint32_t lost;		/* load conversions used for temperature */
+};
+
+void NAU7802_initTempComp(struct temp_comp *tc, int interval_ms, int gain);
+
+int NAU7802_getTempCompLoad(int fd, struct temp_comp *tc, struct load_cal *lc,
+		double *load);
+
+int32_t NAU7802_tempCompRaw(struct temp_comp *tc, int32_t raw);
+
+int NAU7802_tempAddZeroPoint(struct temp_comp *tc, int32_t raw);
+
+int NAU7802_tempAddSpanPoint(struct temp_comp *tc, int32_t raw_zero, int32_t raw_span);
+
+double NAU7802_tempLostPerRead(struct temp_comp *tc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,408 @@
+/*
+ * Sweep filter settings over a recording from NAU7802_record.c
+ * on every core and print the Pareto front of noise, step
+ * latency and settling time.  Each setting is a filter type,
+ * shift bits, LPF_Beta and averaging window:
+ *	lpf	NAU7802_getSmoothLoadFromADC
+ *	avg	moving average of window loads
+ *	avglpf	moving average, then the LPF
+ * Loads are in raw counts at shift 0, so settings compare.
+ *
+ * Steps are found in the raw values first: a step is where
+ * the means of the window before and after differ by more
+ * than SWEEP_STEP_SIGMA standard errors.  Between steps the
+ * second half of each segment is taken as settled; its mean
+ * is the level the filter should reach and its spread the
+ * noise.  Latency is the time to half the step, settling the
+ * time to stay within SWEEP_BAND of it.  Every setting runs
+ * two passes over the recording and keeps no per-sample
+ * output, so threads share only the read-only recording and
+ * scale with cores.
+ *
+ * ./SweepFilter file [threads]
+ * ./SweepFilter /tmp/load.rec 4
+ */
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define SWEEP_MAX_THREADS 64
+#define SWEEP_MAX_STEPS 4096
+#define SWEEP_STEP_SIGMA 8.0	/* step threshold in standard errors */
+#define SWEEP_BAND 0.02		/* settled within 2% of the step */
+#define SWEEP_MAX_WINDOW 64
+
+/* filter types */
+#define FILT_LPF 0
+#define FILT_AVG 1
+#define FILT_AVG_LPF 2
+
+static const char *filt_name[] = {"lpf", "avg", "avglpf"};
+static const int shifts[] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+static const double betas[] = {0.02, 0.05, 0.1, 0.15, 0.2, 0.3, 0.5};
+static const int windows[] = {2, 4, 8, 16, 32, SWEEP_MAX_WINDOW};
+
+#define NELEM(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+struct sweep_param{
+	int type;		/* FILT_ type */
+	int shift;		/* shift bits */
+	double beta;		/* LPF_Beta, 1 for avg */
+	int window;		/* average length, 1 for lpf */
+};
+
+struct sweep_result{
+	double noise;		/* pooled sd of settled segments in counts */
+	double latency_s;	/* mean time to half of a step */
+	double settle_s;	/* mean time to stay within SWEEP_BAND */
+	int front;		/* 1 if on the Pareto front */
+};
+
+/* filter state of one setting */
+struct sweep_filter{
+	struct load_cal lc;
+	const struct sweep_param *p;
+	double ring[SWEEP_MAX_WINDOW];
+	double sum;
+	int len, idx;
+};
+
+/* the recording and segments, read only while sweeping */
+static int32_t *raw;
+static uint64_t *t_ns;
+static long nsamples;
+static long bound[SWEEP_MAX_STEPS + 2];	/* segment starts, then nsamples */
+static int nseg;
+
+static struct sweep_param *param;
+static struct sweep_result *result;
+static int nparam;
+static atomic_int next_param;
+
+static void
+filter_init(struct sweep_filter *f, const struct sweep_param *p, int32_t first){
+	memset(f, 0, sizeof(*f));
+	f->p = p;
+	NAU7802_init_load_cal(&f->lc);
+	NAU7802_setLoadCalGain(&f->lc, (double)(1 << p->shift));
+	NAU7802_setShiftLoad(&f->lc, p->shift);
+	f->lc.LPF_Beta = p->beta;
+	/* start settled on the first value */
+	f->lc.smoothLoad = NAU7802_getLoadFromADC(&f->lc, first);
+}
+
+/*
+ * Filter the next raw value.
+ *
+ * Return the filter output.
+ */
+static double
+filter_next(struct sweep_filter *f, int32_t r){
+	double x;
+	if(f->p->type == FILT_LPF)
+		return NAU7802_getSmoothLoadFromADC(&f->lc, r);
+	x = NAU7802_getLoadFromADC(&f->lc, r);
+	if(f->len == f->p->window)
+		f->sum -= f->ring[f->idx];
+	else
+		f->len++;
+	f->ring[f->idx] = x;
+	f->sum += x;
+	if(++f->idx == f->p->window)
+		f->idx = 0;
+	x = f->sum / f->len;
+	if(f->p->type == FILT_AVG)
+		return x;
+	f->lc.smoothLoad -= f->lc.LPF_Beta * (f->lc.smoothLoad - x);
+	return f->lc.smoothLoad;
+}
+
+/*
+ * Score one setting.  The first pass gets the
+ * settled level and noise of every segment, the
+ * second the latency and settling of every step.
+ */
+static void
+evaluate(const struct sweep_param *p, struct sweep_result *res){
+	struct sweep_filter f;
+	double level[SWEEP_MAX_STEPS + 1];
+	double y, s1, s2, var=0.0, lat=0.0, set=0.0, size, pre;
+	long i, half, cnt=0, hit, last;
+	int j;
+
+	filter_init(&f, p, raw[0]);
+	for(j=0; j<nseg; j++){
+		half = bound[j] + (bound[j + 1] - bound[j]) / 2;
+		s1 = s2 = 0.0;
+		for(i=bound[j]; i<bound[j + 1]; i++){
+			y = filter_next(&f, raw[i]);
+			if(i >= half){
+				s1 += y;
+				s2 += y * y;
+			}
+		}
+		half = bound[j + 1] - half;
+		level[j] = half ? s1 / half : 0.0;
+		if(half > 1){
+			var += fmax(s2 - s1 * s1 / half, 0.0);
+			cnt += half - 1;
+		}
+	}
+	res->noise = cnt ? sqrt(var / cnt) : 0.0;
+
+	filter_init(&f, p, raw[0]);
+	for(j=0; j<nseg; j++){
+		pre = j ? level[j - 1] : level[0];
+		size = level[j] - pre;
+		hit = last = -1;
+		for(i=bound[j]; i<bound[j + 1]; i++){
+			y = filter_next(&f, raw[i]);
+			if(j == 0)
+				continue;
+			if(hit < 0 && (y - pre) / size >= 0.5)
+				hit = i;
+			if(fabs(y - level[j]) > SWEEP_BAND * fabs(size))
+				last = i;
+		}
+		if(j == 0)
+			continue;
+		i = hit < 0 ? bound[j + 1] - 1 : hit;
+		lat += (t_ns[i] - t_ns[bound[j]]) / 1e9;
+		i = last + 1 < bound[j + 1] ? last + 1 : bound[j + 1] - 1;
+		if(last >= 0)
+			set += (t_ns[i] - t_ns[bound[j]]) / 1e9;
+	}
+	res->latency_s = nseg > 1 ? lat / (nseg - 1) : 0.0;
+	res->settle_s = nseg > 1 ? set / (nseg - 1) : 0.0;
+}
+
+static void *
+sweep_thread(void *arg){
+	int k;
+	while((k = atomic_fetch_add(&next_param, 1)) < nparam)
+		evaluate(&param[k], &result[k]);
+	return NULL;
+}
+
+/*
+ * Find steps in the raw values and fill bound.
+ *
+ * Return the number of segments.
+ */
+static int
+find_steps(int rate){
+	int64_t *pre;
+	double sd, d, thr, m, mag;
+	long i, w, best, cnt;
+	int n=0;
+
+	w = rate / 4 > 4 ? rate / 4 : 4;
+	bound[n++] = 0;
+	if(nsamples < 4 * w){
+		bound[n] = nsamples;
+		return n;
+	}
+	/* noise from the differences of neighbours without the steps */
+	sd = 0.0;
+	for(i=1; i<nsamples; i++){
+		d = (double)raw[i] - raw[i - 1];
+		sd += d * d;
+	}
+	sd = sqrt(sd / (nsamples - 1));
+	m = 0.0;
+	cnt = 0;
+	for(i=1; i<nsamples; i++){
+		d = (double)raw[i] - raw[i - 1];
+		if(fabs(d) <= 5.0 * sd){
+			m += d * d;
+			cnt++;
+		}
+	}
+	sd = cnt ? sqrt(m / cnt / 2.0) : sd;
+	if(sd < 1.0)
+		sd = 1.0;
+	thr = SWEEP_STEP_SIGMA * sd * sqrt(2.0 / w);
+
+	pre = malloc((nsamples + 1) * sizeof(*pre));
+	if(pre == NULL){
+		bound[n] = nsamples;
+		return n;
+	}
+	pre[0] = 0;
+	for(i=0; i<nsamples; i++)
+		pre[i + 1] = pre[i] + raw[i];
+	for(i=w; i+w<=nsamples && n<=SWEEP_MAX_STEPS; i++){
+		d = (double)(pre[i + w] - pre[i]) / w - (double)(pre[i] - pre[i - w]) / w;
+		if(fabs(d) <= thr)
+			continue;
+		/* the largest difference of this step */
+		best = i;
+		mag = fabs(d);
+		for(; i+w<=nsamples; i++){
+			d = (double)(pre[i + w] - pre[i]) / w -
+				(double)(pre[i] - pre[i - w]) / w;
+			if(fabs(d) <= thr)
+				break;
+			if(fabs(d) > mag){
+				mag = fabs(d);
+				best = i;
+			}
+		}
+		if(best - bound[n - 1] >= 2 * w)
+			bound[n++] = best;
+		i = best + w;
+	}
+	free(pre);
+	bound[n] = nsamples;
+	return n;
+}
+
+/*
+ * Return 1 if a is at least as good as b in every
+ * score and better in one.
+ */
+static int
+dominates(const struct sweep_result *a, const struct sweep_result *b){
+	return a->noise <= b->noise && a->latency_s <= b->latency_s &&
+		a->settle_s <= b->settle_s &&
+		(a->noise < b->noise || a->latency_s < b->latency_s ||
+		 a->settle_s < b->settle_s);
+}
+
+static int
+by_noise(const void *a, const void *b){
+	const struct sweep_result *x = &result[*(const int *)a];
+	const struct sweep_result *y = &result[*(const int *)b];
+	return (x->noise > y->noise) - (x->noise < y->noise);
+}
+
+static void
+add_param(int type, int shift, double beta, int window){
+	param[nparam].type = type;
+	param[nparam].shift = shift;
+	param[nparam].beta = beta;
+	param[nparam].window = window;
+	nparam++;
+}
+
+int
+main(int argc, char **argv){
+	pthread_t th[SWEEP_MAX_THREADS];
+	struct rec_header hdr;
+	struct rec_sample *rec;
+	uint64_t t0, period;
+	double secs;
+	int i, j, k, s, nth, rate, *order, nfront=0;
+	long n, m;
+
+	if(argc < 2 || argc > 3){
+		printf("Usage : %s file [threads]\n", argv[0]);
+		return 1;
+	}
+	nth = argc == 3 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(nth < 1)
+		nth = 1;
+	if(nth > SWEEP_MAX_THREADS)
+		nth = SWEEP_MAX_THREADS;
+	n = NAU7802_replayLoad(argv[1], &hdr, &rec);
+	if(n < 2){
+		printf("Cannot load %s\n", argv[1]);
+		return 1;
+	}
+	/* good samples only, as arrays */
+	raw = malloc(n * sizeof(*raw));
+	t_ns = malloc(n * sizeof(*t_ns));
+	if(raw == NULL || t_ns == NULL){
+		printf("Out of memory\n");
+		return 1;
+	}
+	for(i=0, m=0; i<n; i++)
+		if(!(rec[i].status & (SAMPLE_IO_ERR | SAMPLE_TIMEOUT))){
+			raw[m] = rec[i].raw;
+			t_ns[m++] = rec[i].t_ns;
+		}
+	free(rec);
+	nsamples = m;
+	if(nsamples < 2){
+		printf("No valid samples in %s\n", argv[1]);
+		return 1;
+	}
+	period = NAU7802_ratePeriod(hdr.rate);
+	if(period == 0){
+		printf("Invalid rate in %s\n", argv[1]);
+		return 1;
+	}
+	rate = 1000000000ULL / period;
+	nseg = find_steps(rate);
+
+	s = NELEM(shifts);
+	param = malloc(s * (NELEM(betas) + NELEM(windows) +
+			NELEM(betas) * NELEM(windows)) * sizeof(*param));
+	if(param == NULL){
+		printf("Out of memory\n");
+		return 1;
+	}
+	for(i=0; i<s; i++){
+		for(j=0; j<NELEM(betas); j++)
+			add_param(FILT_LPF, shifts[i], betas[j], 1);
+		for(k=0; k<NELEM(windows); k++)
+			add_param(FILT_AVG, shifts[i], 1.0, windows[k]);
+		for(j=0; j<NELEM(betas); j++)
+			for(k=0; k<NELEM(windows); k++)
+				add_param(FILT_AVG_LPF, shifts[i], betas[j], windows[k]);
+	}
+	result = calloc(nparam, sizeof(*result));
+	order = malloc(nparam * sizeof(*order));
+	if(result == NULL || order == NULL){
+		printf("Out of memory\n");
+		return 1;
+	}
+
+	printf("%ld samples, %.1f s at %i SPS, %i steps, %i settings, %i threads\n",
+			nsamples, (t_ns[nsamples - 1] - t_ns[0]) / 1e9, rate,
+			nseg - 1, nparam, nth);
+	t0 = NAU7802_getTimestamp();
+	atomic_init(&next_param, 0);
+	for(i=0; i<nth; i++)
+		pthread_create(&th[i], NULL, sweep_thread, NULL);
+	for(i=0; i<nth; i++)
+		pthread_join(th[i], NULL);
+	secs = (NAU7802_getTimestamp() - t0) / 1e9;
+	printf("Swept in %.3f s, %.1f M samples per second\n", secs,
+			2.0 * nsamples * nparam / secs / 1e6);
+
+	for(i=0; i<nparam; i++){
+		result[i].front = 1;
+		for(j=0; j<nparam && result[i].front; j++)
+			if(j != i && dominates(&result[j], &result[i]))
+				result[i].front = 0;
+		if(result[i].front)
+			order[nfront++] = i;
+	}
+	qsort(order, nfront, sizeof(*order), by_noise);
+	if(nseg < 2)
+		printf("No steps found, latency and settling are 0\n");
+	printf("%-7s %5s %6s %6s %12s %12s %12s\n", "filter", "shift", "beta",
+			"window", "noise", "latency ms", "settle ms");
+	for(i=0; i<nfront; i++){
+		k = order[i];
+		printf("%-7s %5i %6.2f %6i %12.2f %12.1f %12.1f\n",
+				filt_name[param[k].type], param[k].shift,
+				param[k].beta, param[k].window, result[k].noise,
+				result[k].latency_s * 1e3, result[k].settle_s * 1e3);
+	}
+	free(order);
+	free(result);
+	free(param);
+	free(raw);
+	free(t_ns);
+	return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * Read loads with a compile time configured NAU7802
+ * (see NAU7802_config.hpp) and print the register
+ * images the compiler worked out.
+ *
+ * ./TestConfig [bus]
+ */
+
+/* include headers */
+#include "NAU7802_config.hpp"
+#include <cstdio>
+
+using sensor = nau7802::Nau7802<nau7802::Gain::x128, nau7802::Rate::sps320,
+	nau7802::Ldo::v3_0>;
+
+/* worked out by the compiler, no register is read */
+static_assert(sensor::ctrl1 == ((V3_0 << 3) | 0x07));
+static_assert(sensor::ctrl2 == (CRS_320 << 4));
+static_assert(sensor::pu_ctrl == 0x96);
+static_assert(sensor::period_ns == 3125000);
+
+int
+main(int argc, char **argv){
+	sensor s(argc >= 2 ? argv[1] : NULL);
+	int i, z;
+
+	printf("PU_CTRL 0x%02X CTRL1 0x%02X CTRL2 0x%02X\n",
+			sensor::pu_ctrl, sensor::ctrl1, sensor::ctrl2);
+	printf("gain %d, %d SPS, %.3g V per count\n",
+			sensor::gain, sensor::sps, sensor::volts_per_count);
+	if(s.fd() < 0){
+		printf("Open Failed\n");
+		return 1;
+	}
+	if((z = s.configure()) != 0)
+		printf("Configure Failed : %d\n", z);
+	s.setCal(0.25, 0.0);
+	for(i=0; i<sensor::sps * 10; i++){
+		while(!s.ready());
+		printf("%f\n", s.readLoad());
+	}
+	return 0;
+}
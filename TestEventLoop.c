@@ -0,0 +1,156 @@
+/*
+ * Serve several NAU7802 streams and stdin from one thread
+ * with epoll.  Each stream fd wakes the loop only when
+ * samples wait, so the loop sleeps between batches.
+ * Prints samples per second, the last load, the lost
+ * conversions, the measured conversion rate and the
+ * recoveries of every sensor once a second, and on q
+ * the latency of every stage from conversion ready to
+ * this loop.
+ *
+ * ./TestEventLoop bus [bus ...]
+ * ./TestEventLoop /dev/i2c-1 /dev/i2c-3
+ */
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_dev.h"
+#include "NAU7802_stream.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define LOOP_MAX_SENSORS 8
+#define LOOP_READ_LEN 64
+
+struct loop_sensor{
+	struct nau7802_dev dev;
+	struct nau7802_stream st;
+	uint32_t cursor;
+	uint32_t lost;
+	uint32_t count;		/* samples this second */
+	double load;		/* last load */
+	struct stream_lat lat;	/* latency per stage */
+};
+
+static const char *stage_name[STREAM_LAT_STAGES] = {
+	"read", "filter", "pop", "total"
+};
+
+static void
+print_latency(const char *bus, struct loop_sensor *s){
+	struct lat_hist *h;
+	int i;
+	NAU7802_streamLatGet(&s->st, &s->lat);
+	printf("%s latency in us, %llu samples\n", bus,
+			(unsigned long long)s->lat.stage[STREAM_LAT_TOTAL].count);
+	printf("%8s %9s %9s %9s %9s %9s\n", "stage", "mean", "p50", "p99",
+			"p999", "max");
+	for(i=0; i<STREAM_LAT_STAGES; i++){
+		h = &s->lat.stage[i];
+		printf("%8s %9.1f %9.1f %9.1f %9.1f %9.1f\n", stage_name[i],
+				NAU7802_histMean(h) / 1e3,
+				NAU7802_histPercentile(h, 50.0) / 1e3,
+				NAU7802_histPercentile(h, 99.0) / 1e3,
+				NAU7802_histPercentile(h, 99.9) / 1e3,
+				(h->count ? h->max : 0) / 1e3);
+	}
+}
+
+static struct loop_sensor sensor[LOOP_MAX_SENSORS];
+
+int
+main(int argc, char **argv){
+	struct epoll_event ev, evs[LOOP_MAX_SENSORS + 1];
+	struct stream_sample buf[LOOP_READ_LEN];
+	struct loop_sensor *s;
+	struct seq_track sq;
+	struct drift_est dr;
+	uint64_t next;
+	char line[16];
+	int ep, n, i, j, k, z, done=0;
+
+	n = argc - 1;
+	if(n < 1 || n > LOOP_MAX_SENSORS){
+		printf("Usage : %s bus [bus ...]\n", argv[0]);
+		return 1;
+	}
+	ep = epoll_create1(EPOLL_CLOEXEC);
+	if(ep == -1){
+		printf("epoll failed\n");
+		return 1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.u32 = LOOP_MAX_SENSORS;
+	epoll_ctl(ep, EPOLL_CTL_ADD, STDIN_FILENO, &ev);
+	for(i=0; i<n; i++){
+		s = &sensor[i];
+		if(NAU7802_devOpen(&s->dev, argv[i + 1], NAU7802_ADDR) == -1){
+			printf("Open Failed : %s\n", argv[i + 1]);
+			return 1;
+		}
+		if((z = NAU7802_devConfigure(&s->dev, 128, CRS_320, V3_0)) != 0)
+			printf("Configure Failed : %s %d\n", argv[i + 1], z);
+		NAU7802_setLoadCalGain(&s->dev.lc, 0.25);
+		NAU7802_setShiftLoad(&s->dev.lc, 0);
+		NAU7802_devTareLoad(&s->dev);
+		if(NAU7802_streamStart(&s->st, &s->dev) == -1){
+			printf("Stream start failed : %s\n", argv[i + 1]);
+			return 1;
+		}
+		s->cursor = NAU7802_streamCursor(&s->st);
+		NAU7802_streamLatInit(&s->lat);
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		epoll_ctl(ep, EPOLL_CTL_ADD, NAU7802_streamFd(&s->st), &ev);
+	}
+
+	next = NAU7802_getTimestamp() + 1000000000ULL;
+	while(!done){
+		z = epoll_wait(ep, evs, LOOP_MAX_SENSORS + 1, 100);
+		for(j=0; j<z; j++){
+			if(evs[j].data.u32 == LOOP_MAX_SENSORS){
+				if(fgets(line, sizeof(line), stdin) == NULL || line[0] == 'q')
+					done = 1;
+				continue;
+			}
+			s = &sensor[evs[j].data.u32];
+			do{
+				k = NAU7802_streamDrain(&s->st, &s->cursor, buf,
+						LOOP_READ_LEN, &s->lost);
+				NAU7802_streamLatPop(&s->lat, buf, k);
+				s->count += k;
+				if(k > 0)
+					s->load = buf[k - 1].load;
+			}while(k == LOOP_READ_LEN);
+		}
+		if(NAU7802_getTimestamp() < next)
+			continue;
+		next += 1000000000ULL;
+		for(i=0; i<n; i++){
+			s = &sensor[i];
+			NAU7802_streamSeqGet(&s->st, &sq);
+			NAU7802_streamDriftGet(&s->st, &dr);
+			printf("%s : %4u SPS  load %10.2f  lost %u  missed %u"
+					"  dup %u  overrun %u  delivered %.4f\n",
+					argv[i + 1], s->count, s->load, s->lost,
+					sq.missed, sq.dups, sq.overruns,
+					NAU7802_seqDelivered(&sq));
+			printf("%*s   rate %.4f SPS  %+.0f ppm  jitter %.1f us"
+					"  recoveries %u (%.1f ms max)\n",
+					(int)strlen(argv[i + 1]), "",
+					NAU7802_driftRate(&dr), NAU7802_driftPPM(&dr),
+					NAU7802_driftJitter(&dr) / 1e3, s->dev.recoveries,
+					s->dev.recover_max_ns / 1e6);
+			s->count = 0;
+		}
+	}
+	for(i=0; i<n; i++){
+		NAU7802_streamStop(&sensor[i].st);
+		print_latency(argv[i + 1], &sensor[i]);
+		NAU7802_devClose(&sensor[i].dev);
+	}
+	close(ep);
+	return 0;
+}
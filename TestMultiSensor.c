@@ -0,0 +1,85 @@
+/*
+ * Read several NAU7802s through the multi-sensor manager.
+ * Each pair of arguments is a bus and the number of mux
+ * channels used on it, 0 for one chip without a mux:
+ *
+ * ./TestMultiSensor /dev/i2c-1 8 /dev/i2c-3 8
+ *
+ * The loads of all sensors are summed as one platform
+ * at 10 Hz, with stats printed every second.
+ */
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_mgr.h"
+#include "NAU7802_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static struct nau7802_mgr mgr;
+static struct platform pf;
+
+int
+main(int argc, char **argv){
+	struct mgr_sample s;
+	struct mgr_stats st;
+	uint64_t next, t;
+	double sum;
+	int i, b, n, ch, z;
+
+	if(argc < 3 || argc % 2 == 0){
+		printf("usage: %s bus channels [bus channels ...]\n", argv[0]);
+		return 1;
+	}
+	NAU7802_mgrInit(&mgr);
+	for(i=1; i+1<argc; i+=2){
+		n = atoi(argv[i+1]);
+		b = NAU7802_mgrAddBus(&mgr, argv[i], n ? TCA9548A_ADDR : MGR_NO_MUX);
+		if(b == -1){
+			printf("Bus open failed : %s\n", argv[i]);
+			return 1;
+		}
+		for(ch=0; ch<(n ? n : 1); ch++){
+			z = NAU7802_mgrAddSensor(&mgr, b, n ? ch : MGR_NO_MUX);
+			if(z == -1)
+				continue;
+			printf("Sensor %i : %s channel %i configure %i\n", z,
+				argv[i], n ? ch : MGR_NO_MUX,
+				NAU7802_mgrConfigure(&mgr, z, 128, CRS_80, V3_0));
+			NAU7802_setLoadCalGain(NAU7802_mgrLoadCal(&mgr, z), 0.25);
+		}
+	}
+	/* 10 Hz output, 25 ms behind to cover an 80 SPS period and the read */
+	if(NAU7802_platformInit(&pf, mgr.nsensors, 10, 25) == -1){
+		printf("Platform setup failed\n");
+		return 1;
+	}
+	if(NAU7802_mgrStart(&mgr) == -1){
+		printf("Start failed\n");
+		return 1;
+	}
+	next = NAU7802_getTimestamp() + 1000000000ULL;
+	for(;;){
+		if(NAU7802_mgrGetSample(&mgr, &s, 100) && !(s.status & SAMPLE_DUP))
+			NAU7802_platformPush(&pf, s.sensor, s.load, s.t_conv_ns);
+		while(NAU7802_platformOutput(&pf, NAU7802_getTimestamp(), &sum, &t))
+			printf("Platform : %+12.4f\n", sum);
+		if(NAU7802_getTimestamp() < next)
+			continue;
+		next += 1000000000ULL;
+		printf("Platform outputs %u held %u\n", pf.outputs, pf.held);
+		for(i=0; i<mgr.nbuses; i++)
+			printf("Bus %i : %.1f SPS\n", i, NAU7802_mgrGetBusRate(&mgr, i));
+		for(i=0; i<mgr.nsensors; i++){
+			NAU7802_mgrGetStats(&mgr, i, &st);
+			printf("Stats %2i : samples %u not ready %u dropped %u mux %u "
+				"period %.3f ms rate %.3f SPS %+.0f ppm "
+				"latency avg %.3f max %.3f ms\n",
+				i, st.samples, st.not_ready, st.dropped, st.mux_switches,
+				st.period_ns / 1e6, st.rate, st.ppm,
+				st.lat_avg_ns / 1e6, st.lat_max_ns / 1e6);
+		}
+	}
+	NAU7802_mgrClose(&mgr);
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Report the jitter of a stream acquisition thread spinning
+ * on CR, with the default thread that sleeps until ready,
+ * and as a real time thread: SCHED_FIFO at prio on CPU cpu
+ * with mlockall and a prefaulted stack.  Each mode runs
+ * seconds.  Jitter is how far the time CR was seen is
+ * from the fitted conversion clock; read is from CR seen
+ * to data read.
+ *
+ * ./TestRealtime seconds bus prio cpu
+ * sudo ./TestRealtime 10 /dev/i2c-1 80 3
+ */
+
+/* include headers */
+#include "NAU7802.h"
+#include "NAU7802_dev.h"
+#include "NAU7802_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define RT_READ_LEN 256
+#define RT_POLL_NS 10000000	/* consumer reads every 10 ms */
+
+static struct nau7802_dev dev;
+static struct nau7802_stream st;
+static struct stream_sample buf[RT_READ_LEN];
+
+static void
+print_row(const char *name, const struct lat_hist *h){
+	printf("  %-7s %9.1f %9.1f %9.1f %9.1f\n", name,
+			NAU7802_histPercentile(h, 50.0) / 1e3,
+			NAU7802_histPercentile(h, 99.0) / 1e3,
+			NAU7802_histPercentile(h, 99.9) / 1e3,
+			(h->count ? h->max : 0) / 1e3);
+}
+
+/*
+ * Run the stream with opts for secs and print
+ * its jitter and read latency.
+ */
+static int
+run_mode(const char *name, const struct stream_opts *opts, double secs){
+	struct timespec ts = {0, RT_POLL_NS};
+	struct lat_hist jitter;
+	struct stream_lat lat;
+	struct seq_track sq;
+	uint64_t end, samples=0;
+	uint32_t cursor, lost=0;
+	int64_t d;
+	int i, n;
+
+	if(NAU7802_streamStartOpts(&st, &dev, opts) == -1){
+		printf("%s : start failed : %s\n", name, strerror(errno));
+		return -1;
+	}
+	NAU7802_histInit(&jitter);
+	cursor = NAU7802_streamCursor(&st);
+	end = NAU7802_getTimestamp() + (uint64_t)(secs * 1e9);
+	while(NAU7802_getTimestamp() < end){
+		nanosleep(&ts, NULL);
+		while((n = NAU7802_streamRead(&st, &cursor, buf, RT_READ_LEN, &lost)) > 0){
+			for(i=0; i<n; i++){
+				if(buf[i].status & SAMPLE_DUP)
+					continue;
+				d = (int64_t)(buf[i].t_cr_ns - buf[i].t_conv_ns);
+				NAU7802_histRecord(&jitter, d < 0 ? -d : d);
+			}
+			samples += n;
+		}
+	}
+	NAU7802_streamStop(&st);
+	NAU7802_streamLatGet(&st, &lat);
+	NAU7802_streamSeqGet(&st, &sq);
+	printf("%s : %.1f SPS  missed %u  overrun %u  lost %u\n", name,
+			samples / secs, sq.missed, sq.overruns, lost);
+	printf("  %-7s %9s %9s %9s %9s  (us)\n", "", "p50", "p99", "p999", "max");
+	print_row("jitter", &jitter);
+	print_row("read", &lat.stage[STREAM_LAT_READ]);
+	return 0;
+}
+
+int
+main(int argc, char **argv){
+	struct stream_opts opts;
+	double secs;
+	int z;
+
+	if(argc != 5){
+		printf("Usage : %s seconds bus prio cpu\n", argv[0]);
+		return 1;
+	}
+	secs = atof(argv[1]);
+	if(NAU7802_devOpen(&dev, argv[2], NAU7802_ADDR) == -1){
+		printf("Open Failed : %s\n", argv[2]);
+		return 1;
+	}
+	if((z = NAU7802_devConfigure(&dev, 128, CRS_320, V3_0)) != 0)
+		printf("Configure Failed : %s %d\n", argv[2], z);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.spin = 1;
+	run_mode("spin", &opts, secs);
+	opts.spin = 0;
+	run_mode("sleep", &opts, secs);
+	/* last, mlockall stays on for the process */
+	opts.prio = atoi(argv[3]);
+	opts.cpu = atoi(argv[4]) + 1;
+	opts.mlock = 1;
+	opts.prefault = 1;
+	run_mode("rt", &opts, secs);
+	NAU7802_devClose(&dev);
+	return 0;
+}
@@ -48,6 +48,11 @@ void hx711_test(){
    for(i=0;i<10;i++){
       printf("\n");
       value = hx711_read_sensor_data();
+      if(value == DBL_MAX){
+         printf("Read failed\n");
+         sleep(1);
+         continue;
+      }
       printf("Value read:%+10.2f      ",value);
       value = hx711_process_sensor_data(value);
       printf("Average value:%+10.2f ",value);
@@ -0,0 +1,39 @@
+/*
+ * Print the latest values published in shared memory by
+ * another process, e.g. TestSensorFunctions, ten times a
+ * second.  Reading does not touch the I2C bus.
+ *
+ * ./TestShmReader [name]
+ */
+
+/* include headers */
+#include "NAU7802_shm.h"
+#include <stdio.h>
+#include <unistd.h>
+
+int
+main(int argc, char **argv){
+	struct shm_region *shm;
+	struct shm_sample s;
+	const char *name = SHM_NAME;
+	unsigned int i;
+
+	if(argc >= 2)
+		name = argv[1];
+	shm = NAU7802_shmOpen(name);
+	if(shm == NULL){
+		printf("Shared memory not found : %s\n", name);
+		return 1;
+	}
+	for(;;){
+		for(i=0; i<shm->nsensors; i++){
+			if(NAU7802_shmRead(shm, i, &s) != 1)
+				continue;
+			printf("Sensor %2u : seq %-8u ADC %-10i Load %+10.4f Filtered %+10.4f\n",
+				i, s.seq / 2, s.raw, s.load, s.filtered);
+		}
+		usleep(100000);
+	}
+	NAU7802_shmClose(shm);
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Subscribe to nau7802d and print the samples it streams.
+ *
+ * ./TestStreamClient [decimation [batch [socket]]]
+ */
+
+/* include headers */
+#include "NAU7802_server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * Read exactly len bytes.
+ *
+ * Return 1 on success or 0 on end of stream.
+ */
+static int
+read_all(int fd, void *buf, size_t len){
+	ssize_t r;
+	size_t n=0;
+	while(n < len){
+		r = read(fd, (char *)buf + n, len - n);
+		if(r <= 0)
+			return 0;
+		n += r;
+	}
+	return 1;
+}
+
+int
+main(int argc, char **argv){
+	struct sockaddr_un addr;
+	struct stream_subscribe q;
+	struct stream_frame f;
+	struct stream_record rec[STREAM_MAX_BATCH];
+	const char *path = SERVER_PATH;
+	int fd, i;
+
+	memset(&q, 0, sizeof(q));
+	q.magic = STREAM_MAGIC;
+	q.decimation = argc >= 2 ? atoi(argv[1]) : 1;
+	q.batch = argc >= 3 ? atoi(argv[2]) : STREAM_DEF_BATCH;
+	q.latency_ms = STREAM_DEF_LATENCY_MS;
+	if(argc >= 4)
+		path = argv[3];
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	if(fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1){
+		printf("Connect failed : %s\n", path);
+		return 1;
+	}
+	if(write(fd, &q, sizeof(q)) != sizeof(q)){
+		printf("Subscribe failed\n");
+		return 1;
+	}
+	while(read_all(fd, &f, sizeof(f))){
+		if(f.magic != STREAM_MAGIC || f.count > STREAM_MAX_BATCH){
+			printf("Bad frame\n");
+			break;
+		}
+		if(!read_all(fd, rec, f.count * sizeof(rec[0])))
+			break;
+		for(i=0; i<f.count; i++)
+			printf("seq %-8u ADC %-10i Load %+10.4f\n",
+				rec[i].seq, rec[i].raw, rec[i].load);
+		if(f.lost)
+			printf("lost %u\n", f.lost);
+	}
+	close(fd);
+	return 0;
+}
@@ -1,6 +1,31 @@
 #!/bin/sh -x
 echo "Creating executables:"
-gcc -Wall -o load NAU7802_driver.c NAU7802.c -lwiringPi -lm
+gcc -Wall -o load NAU7802_driver.c NAU7802.c NAU7802_event.c \
+	NAU7802_capture.c NAU7802_lut.c NAU7802_temp.c NAU7802_dual.c \
+	NAU7802_record.c -lwiringPi -lm -lpthread
 gcc -Wall -o test test.c NAU7802.c -lwiringPi
-gcc -Wall -o TestSensorFunctions TestSensorFunctions.c SensorFunctions.c NAU7802.c -lwiringPi -lm
-
+gcc -Wall -o TestSensorFunctions TestSensorFunctions.c SensorFunctions.c NAU7802.c \
+	NAU7802_dev.c NAU7802_shm.c hx711.c -lwiringPi -lm -lpthread -lrt
+gcc -Wall -o TestMultiSensor TestMultiSensor.c NAU7802.c NAU7802_dev.c \
+	NAU7802_shm.c NAU7802_sched.c NAU7802_seq.c NAU7802_drift.c \
+	NAU7802_mgr.c NAU7802_platform.c -lwiringPi -lm -lpthread -lrt
+gcc -Wall -o TestShmReader TestShmReader.c NAU7802_shm.c -lrt
+gcc -Wall -o nau7802d NAU7802_daemon.c NAU7802.c NAU7802_dev.c NAU7802_shm.c \
+	NAU7802_stream.c NAU7802_hist.c NAU7802_seq.c NAU7802_drift.c \
+	NAU7802_sched.c NAU7802_server.c NAU7802_stats.c -lwiringPi -lm -lpthread -lrt
+gcc -Wall -o TestStreamClient TestStreamClient.c
+gcc -Wall -o TestEventLoop TestEventLoop.c NAU7802.c NAU7802_dev.c \
+	NAU7802_shm.c NAU7802_stream.c NAU7802_hist.c NAU7802_seq.c \
+	NAU7802_drift.c NAU7802_sched.c -lwiringPi -lm -lpthread -lrt
+gcc -Wall -c NAU7802.c NAU7802_dev.c NAU7802_shm.c NAU7802_sched.c
+g++ -Wall -std=c++20 -o BenchCoroutine BenchCoroutine.cpp NAU7802.o \
+	NAU7802_dev.o NAU7802_shm.o NAU7802_sched.o -lwiringPi -lm -lpthread -lrt
+g++ -Wall -std=c++20 -o TestConfig TestConfig.cpp -lwiringPi
+gcc -Wall -O2 -o BenchConv BenchConv.c NAU7802.c NAU7802_conv.c -lwiringPi -lm
+gcc -Wall -o BenchPoll BenchPoll.c NAU7802.c NAU7802_dev.c NAU7802_shm.c \
+	NAU7802_sched.c -lwiringPi -lm -lpthread -lrt
+gcc -Wall -o TestRealtime TestRealtime.c NAU7802.c NAU7802_dev.c NAU7802_shm.c \
+	NAU7802_stream.c NAU7802_hist.c NAU7802_seq.c NAU7802_drift.c \
+	NAU7802_sched.c -lwiringPi -lm -lpthread -lrt
+gcc -Wall -O2 -o SweepFilter SweepFilter.c NAU7802.c NAU7802_record.c \
+	-lwiringPi -lm -lpthread
@@ -2,76 +2,91 @@
 #include <stdio.h>
 #include "NAU7802.h"
 #include "SensorFunctions.h"
+#include "hx711.h"
+#include "NAU7802_shm.h"
 
-static struct load_cal lc;
-static int fd = 0;
+/* device used by the single sensor interface */
+static struct nau7802_dev dev;
 
 int hx711_initialize(void){
+   struct shm_region *shm;
+   int fd;
    printf("Initializing sensor\n\n");
-   fd = init_sensor();
-   calibrate_sensor(fd);
-   NAU7802_init_load_cal(&lc);
-   NAU7802_setLoadCalGain(&lc, 0.25);
-   NAU7802_setShiftLoad(&lc, 0);
-   NAU7802_calibrate(fd, CALMOD_GCS);
-   NAU7802_getLinearLoad(fd, &lc);
-   delay(500);
-   NAU7802_tareLoad(fd, &lc);
+   fd = hx711_open(&dev, DEV_DEFAULT_BUS);
+   /* other processes read the values with NAU7802_shmRead,
+      load and filtered both in kilograms */
+   shm = NAU7802_shmCreate(SHM_NAME, 1);
+   if(shm == NULL){
+      printf("Shared memory failed : %s\n", SHM_NAME);
+   }
+   else{
+      NAU7802_devPublish(&dev, shm, 0);
+   }
    return fd;
 }
 
 double hx711_read_sensor_data(void){
-   static int first_call = 0;
-   double load_value = 0.0;
-   if(first_call == 0){
-	//fd = hx711_initialize();
-        first_call = 1;
-   }
-   while(!NAU7802_CR(fd));
-   load_value = NAU7802_readADC(fd); 
-   load_value = NAU7802_getLinearLoad(fd, &lc);
-   load_value = convert_to_kilograms(load_value);
-   /* Place value in shared memory */
-   return load_value;
+   return hx711_dev_read_sensor_data(&dev);
 }
 
-#define LEN  10
-
 double hx711_process_sensor_data(double value){
-   static double array[LEN] = {0.0};
-   static unsigned int index = 0;
-   static int count = 0;
-   double sum = 0;
-   int i;
-   /* Read a value from shared memory and find average */
-   array[index] = value;
-   index ++;
-   if(index >= LEN){
-      index = 0;
-   }
-   if(count < LEN){
-      count++;
+   return hx711_dev_process_sensor_data(&dev, value);
+}
+
+int hx711_log_sensor_data(double value){
+   return hx711_dev_log_sensor_data(&dev, "weight_sensor.log", value);
+}
+
+int hx711_open(struct nau7802_dev *dev, const char *bus){
+   int z;
+   if(NAU7802_devOpen(dev, bus, NAU7802_ADDR) == -1){
+      printf("Open Failed : %s\n", bus ? bus : "default bus");
+      return -1;
    }
-   sum = 0.0;
-   for(i=0;i<count;i++){
-      sum += array[i];
+   if((z = NAU7802_devConfigure(dev, 128, CRS_10, V3_0)) != 0){
+      printf("Configure Failed : %d\n", z);
    }
-   value = sum/count;
-   /* Place resut value in shared memory */
+   NAU7802_devLock(dev);
+   /* the handle converts to kilograms, so everything it
+      publishes and averages is in one unit; this is
+      convert_to_kilograms(0.25) kept in double */
+   NAU7802_setLoadCalGain(&dev->lc, 0.25 / 2.2);
+   NAU7802_setShiftLoad(&dev->lc, 0);
+   NAU7802_calibrate(dev->fd, CALMOD_GCS);
+   NAU7802_getLinearLoad(dev->fd, &dev->lc);
+   delay(500);
+   NAU7802_tareLoad(dev->fd, &dev->lc);
+   NAU7802_devUnlock(dev);
+   return dev->fd;
+}
+
+void hx711_close(struct nau7802_dev *dev){
+   NAU7802_devClose(dev);
+}
+
+double hx711_dev_read_sensor_data(struct nau7802_dev *dev){
+   double load_value = 0.0;
+   /* kilograms, DBL_MAX if the read failed; the value
+      is placed in shared memory by the handle */
+   load_value = NAU7802_devReadLoad(dev);
+   return load_value;
+}
+
+double hx711_dev_process_sensor_data(struct nau7802_dev *dev, double value){
+   /* find average, the handle places it in shared memory */
+   value = NAU7802_devAverageLoad(dev, value);
    return value;
 }
 
-int hx711_log_sensor_data(double value){
-   static int first_call = 0;
+int hx711_dev_log_sensor_data(struct nau7802_dev *dev, const char *fname, double value){
    int status = 0;
-   static int log_fd = 0;
-   /* Read value in shared memory */
-   if(first_call == 0){
-      log_fd = open_file("weight_sensor.log");
-      first_call = 1;
+   NAU7802_devLock(dev);
+   if(dev->log_fd == 0){
+      dev->log_fd = open_file(fname);
    }
    if(status == 0){
-     status = write_to_file(log_fd,value);
+     status = write_to_file(dev->log_fd,value);
    }
+   NAU7802_devUnlock(dev);
    return status;
 }
@@ -1,6 +1,14 @@
 /* AADL interface functions */
+#include "NAU7802_dev.h"
 
 int hx711_initialize(void);
 double hx711_read_sensor_data(void);
 double hx711_process_sensor_data(double value);
 int hx711_log_sensor_data(double value);
+
+/* handle versions for several sensors and threads */
+int hx711_open(struct nau7802_dev *dev, const char *bus);
+void hx711_close(struct nau7802_dev *dev);
+double hx711_dev_read_sensor_data(struct nau7802_dev *dev);
+double hx711_dev_process_sensor_data(struct nau7802_dev *dev, double value);
+int hx711_dev_log_sensor_data(struct nau7802_dev *dev, const char *fname, double value);